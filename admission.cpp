@@ -0,0 +1,217 @@
+#include <admission.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace topo
+{
+    namespace admission {
+
+    namespace
+    {
+        // "some avg10=1.51 avg60=3.10 avg300=3.09 total=181250582"
+        //
+
+        bool
+        read_pressure(std::string const &path, pressure &p)
+        {
+            std::ifstream in(path);
+            std::string line;
+
+            while (std::getline(in, line))
+            {
+                if (line.compare(0, 5, "some ") != 0)
+                    continue;
+
+                auto avg = line.find("avg10=");
+                auto tot = line.find("total=");
+                if (avg == std::string::npos || tot == std::string::npos)
+                    return false;
+
+                p.avg10 = std::strtod(line.c_str() + avg + 6, nullptr);
+                p.total = std::strtoull(line.c_str() + tot + 6, nullptr, 10);
+                return true;
+            }
+
+            return false;
+        }
+
+        unsigned int
+        count_cpus(std::string const &path)
+        {
+            std::ifstream in(path);
+            std::string line;
+            unsigned int n = 0;
+
+            while (std::getline(in, line))
+                n += line.compare(0, 3, "cpu") == 0 && line.size() > 3 && isdigit(line[3]);
+
+            if (n == 0)
+            {
+                auto c = sysconf(_SC_NPROCESSORS_ONLN);
+                n = c > 0 ? static_cast<unsigned int>(c) : 1;
+            }
+
+            return n;
+        }
+
+        // stall % over the last interval, from the totals of two samples
+        // (avg10 lags behind by seconds), or avg10 for the first one...
+        //
+
+        double
+        stall(pressure const &prev, pressure const &cur, clock_type::duration d, bool first)
+        {
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+            if (first || us <= 0 || cur.total < prev.total)
+                return cur.avg10;
+            return 100.0 * static_cast<double>(cur.total - prev.total) / static_cast<double>(us);
+        }
+    }
+
+    sample
+    read(std::string const &proc)
+    {
+        sample s;
+        memset(&s, 0, sizeof(s));
+
+        // "0.54 0.79 0.70 2/73 32506"
+        //
+
+        std::ifstream loadavg(proc + "/loadavg");
+        std::string l5, l15, threads;
+
+        if (loadavg >> s.load1 >> l5 >> l15 >> threads)
+            s.runnable = static_cast<unsigned int>(std::strtoul(threads.c_str(), nullptr, 10));
+
+        s.ncpu = count_cpus(proc + "/stat");
+
+        s.has_pressure = read_pressure(proc + "/pressure/cpu", s.cpu) &&
+                         read_pressure(proc + "/pressure/io", s.io) &&
+                         read_pressure(proc + "/pressure/memory", s.memory);
+
+        std::ifstream meminfo(proc + "/meminfo");
+        std::string key;
+        uint64_t value;
+        std::string unit;
+
+        while (meminfo >> key >> value >> unit)
+        {
+            if (key == "MemTotal:")
+                s.mem_total = value;
+            else if (key == "MemAvailable:")
+                s.mem_available = value;
+        }
+
+        return s;
+    }
+
+
+    controller::controller(std::string const &proc, limits const &l)
+    : proc_(proc)
+    , limits_(l)
+    , rate_(l.initial_rate)
+    , tokens_(std::min(1.0, l.burst))
+    , congested_(false)
+    , hold_(false)
+    , sampled_(false)
+    , last_()
+    , last_sample_()
+    , last_refill_()
+    , hold_start_()
+    , admitted_(0)
+    , waits_(0)
+    , held_(clock_type::duration::zero())
+    {}
+
+    void
+    controller::update(clock_type::time_point now)
+    {
+        auto s = read(proc_);
+        auto d = now - last_sample_;
+        bool first = !sampled_;
+
+        if (hold_ && !first)
+            held_ += d;
+
+        double cpu = 0, io = 0, mem = 0;
+
+        if (s.has_pressure)
+        {
+            bool pfirst = first || !last_.has_pressure;
+
+            cpu = stall(last_.cpu, s.cpu, d, pfirst);
+            io  = stall(last_.io, s.io, d, pfirst);
+            mem = stall(last_.memory, s.memory, d, pfirst);
+        }
+
+        double avail = s.mem_total ? 100.0 * static_cast<double>(s.mem_available) / static_cast<double>(s.mem_total) : 100.0;
+
+        congested_ = cpu > limits_.cpu_stall ||
+                     io  > limits_.io_stall  ||
+                     mem > limits_.memory_stall ||
+                     s.runnable > limits_.runnable * s.ncpu ||
+                     avail < limits_.mem_low;
+
+        // out of memory: no launch, for at most hold_timeout...
+        //
+
+        if (avail < limits_.mem_floor)
+        {
+            if (!hold_ && hold_start_ == clock_type::time_point())
+                hold_start_ = now;
+            hold_ = now - hold_start_ < limits_.hold_timeout;
+        }
+        else
+        {
+            hold_ = false;
+            hold_start_ = clock_type::time_point();
+        }
+
+        if (!first)
+            rate_ = congested_ ? std::max(limits_.min_rate, rate_ / 2)
+                               : std::min(limits_.max_rate, rate_ + limits_.step);
+
+        last_ = s;
+        last_sample_ = now;
+        sampled_ = true;
+    }
+
+    clock_type::duration
+    controller::admit(clock_type::time_point now)
+    {
+        if (!sampled_ || now - last_sample_ >= limits_.interval)
+            update(now);
+
+        if (last_refill_ != clock_type::time_point())
+        {
+            auto dt = std::chrono::duration<double>(now - last_refill_).count();
+            tokens_ = std::min(limits_.burst, tokens_ + rate_ * dt);
+        }
+
+        last_refill_ = now;
+
+        if (!hold_ && tokens_ >= 1)
+        {
+            tokens_ -= 1;
+            admitted_++;
+            return clock_type::duration::zero();
+        }
+
+        waits_++;
+
+        if (hold_)
+            return limits_.interval;
+
+        auto wait = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>((1 - tokens_) / rate_));
+
+        return std::min<clock_type::duration>(std::max<clock_type::duration>(wait, std::chrono::milliseconds(1)), limits_.interval);
+    }
+
+    } // namespace admission
+}
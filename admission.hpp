@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace topo
+{
+    namespace admission
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // admission control of the VM launches: a token bucket whose rate
+        // adapts to the load of the host (AIMD). The rate grows by a fixed
+        // step while the host keeps up, and is halved as soon as the CPU,
+        // IO or memory stall, the runnable threads or the free memory say
+        // the launches are queueing behind each other. The launches stop
+        // altogether while the available memory is below a floor.
+        //
+        // The state of the host is read from a proc directory (/proc, or a
+        // fake one for tests): loadavg, stat, meminfo, pressure/{cpu,io,memory}.
+        //
+
+        typedef std::chrono::steady_clock clock_type;
+
+        struct pressure
+        {
+            double avg10;               // % of the last 10 seconds ("some" line)
+            uint64_t total;             // us stalled since boot
+        };
+
+        struct sample
+        {
+            double load1;
+            unsigned int runnable;      // threads running now
+            unsigned int ncpu;
+            bool has_pressure;          // PSI available
+            pressure cpu;
+            pressure io;
+            pressure memory;
+            uint64_t mem_total;         // kB
+            uint64_t mem_available;     // kB
+        };
+
+        sample read(std::string const &proc);
+
+        struct limits
+        {
+            limits()
+            : initial_rate(4)
+            , min_rate(0.5)
+            , max_rate(64)
+            , step(1)
+            , burst(4)
+            , cpu_stall(20)
+            , io_stall(20)
+            , memory_stall(10)
+            , runnable(1.5)
+            , mem_low(10)
+            , mem_floor(5)
+            , interval(std::chrono::milliseconds(200))
+            , hold_timeout(std::chrono::seconds(30))
+            {}
+
+            double initial_rate;        // launches/s
+            double min_rate;
+            double max_rate;
+            double step;                // launches/s added per calm interval
+            double burst;               // tokens
+
+            double cpu_stall;           // % of the interval, above which the host is congested
+            double io_stall;
+            double memory_stall;
+            double runnable;            // runnable threads per cpu
+            double mem_low;             // % of the memory available
+            double mem_floor;           // % below which no VM is launched...
+
+            clock_type::duration interval;
+            clock_type::duration hold_timeout;  // ...for at most this long
+        };
+
+        class controller
+        {
+        public:
+            explicit controller(std::string const &proc, limits const &l = limits());
+
+            // admit a launch at time now: zero if admitted, otherwise the
+            // time to wait before asking again...
+            //
+
+            clock_type::duration admit(clock_type::time_point now);
+
+            double rate() const          { return rate_; }
+            bool congested() const       { return congested_; }
+            size_t admitted() const      { return admitted_; }
+            size_t waits() const         { return waits_; }
+            clock_type::duration held() const  { return held_; }
+
+        private:
+            void update(clock_type::time_point now);
+
+            std::string proc_;
+            limits limits_;
+
+            double rate_;
+            double tokens_;
+            bool congested_;
+            bool hold_;
+
+            bool sampled_;
+            sample last_;
+            clock_type::time_point last_sample_;
+            clock_type::time_point last_refill_;
+            clock_type::time_point hold_start_;
+
+            size_t admitted_;
+            size_t waits_;
+            clock_type::duration held_;
+        };
+
+    } // namespace admission
+
+} // namespace topo
@@ -1,10 +1,24 @@
 #include <builder.hpp>
 #include <script.hpp>
-#include <global.hpp>
+#include <exec.hpp>
+#include <dag.hpp>
+#include <netlink.hpp>
+#include <emitter.hpp>
+#include <qmp.hpp>
+#include <monitor.hpp>
+#include <teardown.hpp>
+#include <stats.hpp>
+#include <prewarm.hpp>
 
 #include <show.hpp>
 
+#include <algorithm>
+#include <numeric>
 #include <vector>
+#include <set>
+#include <map>
+#include <iostream>
+#include <fstream>
 #include <string>
 
 namespace topo
@@ -37,6 +51,16 @@ namespace topo
             }
         }
         
+        // point-to-point links join exactly two ports...
+        //
+
+        for(auto &p : ret)
+        {
+            if (node_type(get_switch(p.second)) == switch_type::p2p && get_num_links(p.second) != 2)
+                throw std::runtime_error("make_switch_map: p2p switch " + p.first + " has " +
+                                         std::to_string(get_num_links(p.second)) + " ports (2 required)");
+        }
+
         // compute the per-switch tap ids...
         //
 
@@ -74,19 +98,12 @@ namespace topo
     }
 
     //
-    // main builder function...
+    // assign the taps to the ports of the nodes, in order...
     //
 
-    int builder(Switches ss, Nodes ns)
+    TapMap
+    make_tap_map(SwitchMap &sm, Nodes const &ns)
     {
-        auto sm = make_switch_map(ss, ns);
-
-        if (global::instance().verbose)
-        {               
-            std::cerr << "switches   : " << ::show (ss) << std::endl;
-            std::cerr << "nodes      : " << ::show (ns) << std::endl;
-        }
-        
         TapMap tm;
 
         for(auto &n : ns)
@@ -103,13 +120,214 @@ namespace topo
             tm[node_name(n)] = std::move(taps);
         }
 
+        return tm;
+    }
+
+    //
+    // taps that must be created multiqueue (the NIC has more than one queue)
+    //
+
+    std::set<int>
+    make_multiqueue_taps(Nodes const &ns, TapMap const &tm, Settings const &st)
+    {
+        std::set<int> ret;
+
+        for(auto &n : ns)
+        {
+            auto t = tm.find(node_name(n));
+            if (t == std::end(tm))
+                throw std::logic_error("make_multiqueue_taps: internal error");
+
+            for(size_t p = 0; p < t->second.size(); ++p)
+            {
+                if (nic_queues(nic_conf(st, node_name(n), p)) > 1)
+                    ret.insert(t->second[p]);
+            }
+        }
+
+        return ret;
+    }
+
+    //
+    // nodes started directly on the same image file corrupt each other:
+    // warn and suggest an overlay...
+    //
+
+    void
+    check_shared_images(Nodes const &ns)
+    {
+        std::map<std::string, std::pair<std::string, size_t>> owner;    // first node, count
+
+        for(auto &n : ns)
+        {
+            auto const & image = node_image(n);
+            if (is_overlay(image) || image.args.empty())
+                continue;
+
+            auto it = owner.insert(std::make_pair(image.args[0], std::make_pair(node_name(n), size_t(0))));
+            it.first->second.second++;
+        }
+
+        for(auto &o : owner)
+        {
+            if (o.second.second > 1)
+                std::cerr << "builder: warning: image " << o.first << " shared by "
+                          << o.second.first << " and " << (o.second.second - 1)
+                          << " other node(s) (use overlay)" << std::endl;
+        }
+    }
+
+    //
+    // the files every VM reads at boot: the kernel, the initramfs, the
+    // base images of the overlays and the images shared by more nodes...
+    //
+
+    std::vector<std::string>
+    boot_files(context const &ctx, Nodes const &ns)
+    {
+        std::vector<std::string> ret { ctx.kernel, ctx.core };
+        std::map<std::string, size_t> images;
+
+        for(auto &n : ns)
+        {
+            auto const & image = node_image(n);
+            if (image.args.empty())
+                continue;
+
+            auto path = image.args[0];
+            if (path.size() > 1 && path.front() == '"' && path.back() == '"')
+                path = path.substr(1, path.size() - 2);
+
+            images[path] += is_overlay(image) ? 2 : 1;
+        }
+
+        for(auto &i : images)
+            if (i.second > 1)
+                ret.push_back(i.first);
+
+        return ret;
+    }
+
+    //
+    // --prewarm: load the boot files into the page cache before the
+    // launches (not in dry-run, where nothing is launched)...
+    //
+
+    void
+    prewarm_boot(context const &ctx, Nodes const &ns, stats::scope &phase)
+    {
+        if (!ctx.prewarm || ctx.dry_run)
+            return;
+
+        phase.next("prewarm");
+
+        auto r = prewarm::run(boot_files(ctx, ns), ctx.jobs);
+
+        prewarm::show(std::cerr, r);
+
+        phase.count("prewarm_files", std::count_if(std::begin(r.files), std::end(r.files), [](prewarm::file const &f) { return f.found; }));
+        phase.count("prewarm_bytes", std::accumulate(std::begin(r.files), std::end(r.files), size_t(0),
+                                                     [](size_t n, prewarm::file const &f) { return n + f.size; }));
+    }
+
+    //
+    // wait for the VMs to be ready: launched are the spawn times of the VMs
+    // (one per node) recorded by exec, otherwise (VMs started elsewhere)
+    // the creation time of the logs is used
+    //
+
+    int
+    monitor_vms(context const &ctx, Nodes const &ns, exec::Launches const &launched = exec::Launches())
+    {
+        std::vector<monitor::target> ts;
+        ts.reserve(ns.size());
+
+        for(size_t i = 0; i < ns.size(); ++i)
+            ts.push_back(monitor::target{node_name(ns[i]), script::log_file(ns[i]),
+                                         i < launched.size() ? launched[i].start : monitor::clock_type::time_point()});
+
+        auto rs = monitor::run(ts, ctx.ready, ctx.ready_timeout * 1000);
+
+        return monitor::show(std::cerr, rs) ? 1 : 0;
+    }
+
+    //
+    // record in the state file the process group of each VM launched, for
+    // the teardown to stop them by group (also after a partial run)...
+    //
+
+    void
+    save_launches(context const &ctx, Nodes const &ns, teardown::State &state, exec::Launches const &launched)
+    {
+        if (ctx.state.empty() || ctx.dry_run)
+            return;
+
+        std::map<std::string, pid_t> pgid;
+        for(size_t i = 0; i < std::min(ns.size(), launched.size()); ++i)
+            if (launched[i].pid > 0)
+                pgid[node_name(ns[i])] = launched[i].pid;
+
+        for(auto & v : state.vms)
+        {
+            auto it = pgid.find(v.name);
+            if (it != std::end(pgid))
+                v.pgid = it->second;
+        }
+
+        teardown::save(ctx.state, state);
+    }
+
+    //
+    // main builder function...
+    //
+
+    int builder(context &ctx, Switches ss, Nodes ns, Settings st)
+    {
+        stats::scope phase(ctx.recorder, "switch_map");
+
+        auto sm = make_switch_map(ss, ns);
+
+        phase.count("switches", ss.size());
+        phase.count("nodes", ns.size());
+        phase.count("ports", std::accumulate(std::begin(sm), std::end(sm), size_t(0),
+                                             [](size_t n, SwitchMap::value_type const &s) { return n + get_num_links(s.second); }));
+
+        if (ctx.monitor && !ctx.execute)
+        {
+            phase.next("monitor");
+            return monitor_vms(ctx, ns);
+        }
+
+        if (ctx.verbose)
+        {               
+            // streamed through a buffer on stderr: no string of the whole maps...
+
+            emit::output err(2);
+            emit::output_buf sb(err);
+            std::ostream log(&sb);
+
+            ::show(log << "switches   : ", ss, ctx.verbose_limit) << std::endl;
+            ::show(log << "nodes      : ", ns, ctx.verbose_limit) << std::endl;
+            ::show(log << "settings   : ", st, ctx.verbose_limit) << std::endl;
+        }
+        
+        phase.next("tap_map");
+
+        auto tm = make_tap_map(sm, ns);
+
+        check_settings(st, sm, tm);
+
         // display maps...
         //
         
-        if (global::instance().verbose)
+        if (ctx.verbose)
         {
-            std::cerr << "switch_map : " <<  ::show(sm) << std::endl;
-            std::cerr << "tap_map    : " <<  ::show(tm) << std::endl;
+            emit::output err(2);
+            emit::output_buf sb(err);
+            std::ostream log(&sb);
+
+            ::show(log << "switch_map : ", sm, ctx.verbose_limit) << std::endl;
+            ::show(log << "tap_map    : ", tm, ctx.verbose_limit) << std::endl;
         }
                  
         //////////////////////////////////////////////////////////////////
@@ -117,26 +335,274 @@ namespace topo
         // dump script...
         //
         
-        auto br = script::make_bridges(sm);
+        check_shared_images(ns);
+
+        // save what is going to be created, for --teardown...
+        //
+
+        teardown::State state;
+
+        if (!ctx.state.empty() && !ctx.dry_run)
+        {
+            phase.next("state");
+            state = teardown::make_state(ctx, sm, ns, tm);
+            teardown::save(ctx.state, state);
+        }
+
+        phase.next("script");
+
+        auto mq = make_multiqueue_taps(ns, tm, st);
+
+        auto br = script::make_bridges(ctx, sm, mq);
+
+        auto sh = script::make_shaping(ns, tm, sm, st);
+        
+        auto kvm = script::make_kvm(ctx);
+
+        auto img = script::make_overlays(ctx, ns);
+
+        auto vms = script::make_vms(ctx, ns, tm, sm, st);
+
+        phase.count("lines", std::count_if(std::begin(br), std::end(br), [](script::line const &l) { return !l.empty(); }) +
+                             sh.cmds.size() +
+                             kvm.size() +
+                             std::count_if(std::begin(img), std::end(img), [](script::line const &l) { return !l.empty(); }) +
+                             vms.size());
+
+        // native bridge setup: the switches handled through rtnetlink
+        // are left with an empty command...
+        //
+
+        if (ctx.netlink)
+        {
+            phase.next("netlink");
+
+            auto native = netlink::make_bridges(sm, mq);
+
+            for(size_t i = 0; i < native.size(); ++i)
+                if (native[i])
+                    br[i].clear();
+        }
+
+        // dependency graph...
+        //
+
+        if (ctx.graph || (ctx.execute && ctx.dag))
+        {
+            phase.next("graph");
+
+            auto g = dag::make_graph(sm, ns, tm, std::move(br), std::move(sh), std::move(kvm), std::move(img), std::move(vms));
+
+            if (!ctx.execute)
+            {
+                phase.next("emit");
+                dag::show_dot(std::cout, g);
+                return 0;
+            }
+
+            prewarm_boot(ctx, ns, phase);
+
+            phase.next("execute");
+
+            exec::Launches launched;
+
+            auto ret = exec::run(g, ctx, &launched);
+
+            save_launches(ctx, ns, state, launched);
+
+            if (ret == 0 && ctx.monitor)
+            {
+                phase.next("monitor");
+                return monitor_vms(ctx, ns, launched);
+            }
+
+            return ret;
+        }
+
+        // overlays (if any) are created before the VMs are started...
+        //
+
+        img.erase(std::remove(img.begin(), img.end(), script::line()), img.end());
+
+        // run the plan directly...
+        //
+
+        if (ctx.execute)
+        {
+            prewarm_boot(ctx, ns, phase);
+
+            phase.next("execute");
+
+            exec::Plan plan;
+
+            plan.emplace_back("bridges", std::move(br));
+            if (!sh.cmds.empty())
+                plan.emplace_back("shaping", std::move(sh.cmds));
+            plan.emplace_back("kvm",     std::move(kvm));
+            if (!img.empty())
+                plan.emplace_back("images", std::move(img));
+            plan.emplace_back("vms",     std::move(vms));
+
+            exec::Launches launched;
+
+            auto ret = exec::run(plan, ctx, &launched);
+
+            save_launches(ctx, ns, state, launched);
+
+            if (ret == 0 && ctx.monitor)
+            {
+                phase.next("monitor");
+                return monitor_vms(ctx, ns, launched);
+            }
+
+            return ret;
+        }
+
+        phase.next("emit");
+
+        auto out = emit::make_emitter(ctx.format, ctx.output);
+
+        out->section("bridges", "make bridges..."); out->commands(br);
+
+        // dump link shaping...
+        //
 
-        std::cout << "\n# make bridges..." << std::endl; script::show(br);
+        if (!sh.cmds.empty()) {
+            out->section("shaping", "shape links..."); out->commands(sh.cmds);
+        }
 
         // dump kvm setup...
         //
         
-        auto kvm = script::make_kvm();
+        out->section("kvm", "setup kvm"); out->commands(kvm);
+
+        // dump overlays...
+        //
 
-        std::cout << "\n# setup kvm" << std::endl; script::show(kvm);
+        if (!img.empty()) {
+            out->section("images", "create overlays..."); out->commands(img);
+        }
 
         // dump VMs...
         //
         
-        auto vms = script::make_vms(ns, tm);
-
-        std::cout << "\n# start VMs..." << std::endl; script::show(vms);
+        out->section("vms", "start VMs..."); out->commands(vms);
 
+        out->flush();
         return 0;
     }
 
 
+    // destroy: tear down the topology deployed from the config...
+    //
+
+    int destroy(context const &ctx, Switches ss, Nodes ns)
+    {
+        auto sm = make_switch_map(ss, ns);
+        auto tm = make_tap_map(sm, ns);
+
+        return teardown::run(teardown::make_state(ctx, sm, ns, tm), ctx);
+    }
+
+
+    // hotplug: compare the running topology (old) with the new one and
+    // change the NICs of the running VMs through their QMP sockets...
+    //
+
+    int hotplug(context const &ctx, Switches ss, Nodes old_ns, Nodes ns)
+    {
+        if (ctx.qmp.empty())
+            throw std::runtime_error("hotplug: QMP socket directory not specified");
+
+        auto sm = make_switch_map(ss, ns);
+
+        std::map<std::string, Node const *> running;
+        for(auto & node : old_ns)
+            running[node_name(node)] = &node;
+
+        // VMs still running and their new NICs...
+        //
+
+        std::vector<std::pair<Node const *, Node const *>> vms;
+        std::vector<std::pair<std::string, std::string>> nics;
+        std::vector<size_t> first_nic;
+
+        for(auto & node : ns)
+        {
+            auto it = running.find(node_name(node));
+            if (it == std::end(running))
+            {
+                std::cerr << "hotplug: " << node_name(node) << ": new VM, not started" << std::endl;
+                continue;
+            }
+
+            auto add = qmp::new_nics(node_ports(*it->second), node_ports(node), sm);
+
+            vms.emplace_back(it->second, &node);
+            first_nic.push_back(nics.size());
+            nics.insert(nics.end(), add.begin(), add.end());
+
+            running.erase(it);
+        }
+
+        first_nic.push_back(nics.size());
+
+        for(auto & r : running)
+            std::cerr << "hotplug: " << r.first << ": VM removed, not stopped" << std::endl;
+
+        // a tap per new NIC, created and enslaved to its bridge before the
+        // VMs are asked to use it...
+        //
+
+        std::vector<std::string> bridges;
+        for(auto & n : nics)
+            bridges.push_back(n.second);
+
+        auto taps = netlink::add_taps(bridges, ctx.dry_run);
+
+        for(size_t i = 0; i < taps.size(); ++i)
+            std::cerr << "hotplug: " << taps[i] << " on " << bridges[i] << std::endl;
+
+        // hot-plugged taps are torn down with the others...
+        //
+
+        if (!ctx.state.empty() && !ctx.dry_run && !taps.empty())
+        {
+            std::ofstream out(ctx.state, std::ios::app);
+            for(auto & t : taps)
+                out << "tap " << t << '\n';
+            if (!out.flush())
+                throw std::runtime_error("hotplug: cannot write " + ctx.state);
+        }
+
+        std::vector<qmp::session> sessions;
+
+        for(size_t v = 0; v < vms.size(); ++v)
+        {
+            std::map<std::string, std::string> nic_taps;
+            for(auto i = first_nic[v]; i < first_nic[v + 1]; ++i)
+                nic_taps[nics[i].first] = taps[i];
+
+            auto cmds = qmp::make_hotplug(node_ports(*vms[v].first), node_ports(*vms[v].second), nic_taps);
+
+            if (cmds.empty())
+                continue;
+
+            auto name = node_name(*vms[v].second);
+            sessions.push_back(qmp::session{name, ctx.qmp + "/" + name + ".sock", std::move(cmds)});
+        }
+
+        if (ctx.dry_run)
+        {
+            for(auto & s : sessions)
+                for(auto & c : s.cmds)
+                    std::cout << s.path << ' ' << c.json << '\n';
+            std::cout.flush();
+            return 0;
+        }
+
+        return qmp::run(sessions) ? 1 : 0;
+    }
+
+
 } // namespace topo
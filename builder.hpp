@@ -1,12 +1,17 @@
 #pragma once 
 
 #include <network.hpp>
+#include <context.hpp>
 
 #include <vector>
 #include <map>
 
 namespace topo 
 {
-    int builder(Switches ss, Nodes ns);
+    int builder(context &ctx, Switches ss, Nodes ns, Settings st = Settings());
+
+    int destroy(context const &ctx, Switches ss, Nodes ns);
+
+    int hotplug(context const &ctx, Switches ss, Nodes old_ns, Nodes ns);
     
 } // namespace topo
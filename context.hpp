@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace topo
+{
+    namespace stats { class recorder; }
+
+    //
+    // build context: the options of a build and its state. Each topology
+    // is built with its own context, so that many of them can be built in
+    // the same process, concurrently.
+    //
+
+    struct context
+    {
+        context()
+        : verbose(false)
+        , append_ip(false)
+        , execute(false)
+        , dag(false)
+        , graph(false)
+        , netlink(false)
+        , dry_run(false)
+        , ptnetmap(false)
+        , monitor(false)
+        , teardown(false)
+        , stats(false)
+        , admission(false)
+        , prewarm(false)
+        , jobs(1)
+        , threads(1)
+        , ready_timeout(300)
+        , stop_timeout(10)
+        , launch_grace(1000)
+        , p2p_port(20000)
+        , verbose_limit(0)
+        , output(1)
+        , recorder(nullptr)
+        , kernel("Core/boot/vmlinuz")
+        , core("Core/boot/core.gz")
+        , shell("/bin/bash")
+        , format("sh")
+        , qmp()
+        , overlay_dir("overlay")
+        , initrd_cache()
+        , vhost_dir("vhost")
+        , hugepages("/dev/hugepages")
+        , ready("login:")
+        , proc("/proc")
+        , state()
+        {}
+
+        bool verbose; 
+        bool append_ip;
+        bool execute;
+        bool dag;
+        bool graph;
+        bool netlink;
+        bool dry_run;
+        bool ptnetmap;
+        bool monitor;
+        bool teardown;
+        bool stats;
+        bool admission;             // throttle the VM launches on the host load
+        bool prewarm;               // load the boot files into the page cache before the launches
+        int jobs;
+        int threads;                // threads generating the VM lines (0: one per CPU)
+        int ready_timeout;
+        int stop_timeout;
+        int launch_grace;           // ms a VM must stay up to count as launched (--execute)
+        int p2p_port;               // UDP port of the p2p port 0 (port N: p2p_port + N)
+        size_t verbose_limit;       // elements shown at each end of a container in -v (0 = all)
+        int output;                 // file descriptor of the generated plan
+
+        stats::recorder *recorder;  // --stats of the current build
+
+        std::string kernel;
+        std::string core;
+        std::string shell;
+        std::string format;
+        std::string qmp;
+        std::string overlay_dir;
+        std::string initrd_cache;   // uncompressed copy of the initramfs (empty: none)
+        std::string vhost_dir;      // vhost-user sockets and port maps
+        std::string hugepages;      // backing of the guest memory shared with vhost-user switches
+        std::string ready;
+        std::string proc;           // host state for --admission
+        std::string state;
+    };
+
+} // namespace topo
@@ -0,0 +1,244 @@
+#include <dag.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace topo
+{
+    namespace dag {
+
+    namespace
+    {
+        int
+        add_vertex(Graph &g, kind k, std::string name, script::line cmd, long cost)
+        {
+            g.type.push_back(k);
+            g.name.push_back(std::move(name));
+            g.cmd.push_back(std::move(cmd));
+            g.cost.push_back(cost);
+            return static_cast<int>(g.cmd.size() - 1);
+        }
+
+        // build the CSR adjacency from the list of edges (counting sort)...
+        //
+
+        void
+        make_csr(Graph &g, std::vector<std::pair<int,int>> const &edges)
+        {
+            auto n = g.size();
+
+            g.first.assign(n + 1, 0);
+            g.npred.assign(n, 0);
+            g.succ.resize(edges.size());
+
+            for(auto & e : edges)
+            {
+                g.first[e.first + 1]++;
+                g.npred[e.second]++;
+            }
+
+            for(size_t v = 0; v < n; ++v)
+                g.first[v+1] += g.first[v];
+
+            std::vector<size_t> pos(g.first.begin(), g.first.end() - 1);
+
+            for(auto & e : edges)
+                g.succ[pos[e.first]++] = e.second;
+        }
+
+        // critical path: rank(v) = cost(v) + max rank(successors),
+        // computed in reverse topological order...
+        //
+
+        void
+        make_rank(Graph &g)
+        {
+            auto n = g.size();
+
+            std::vector<int> order; order.reserve(n);
+            std::vector<int> npred(g.npred);
+
+            for(size_t v = 0; v < n; ++v)
+                if (npred[v] == 0)
+                    order.push_back(static_cast<int>(v));
+
+            for(size_t i = 0; i < order.size(); ++i)
+            {
+                auto v = order[i];
+                for(auto e = g.first[v]; e != g.first[v+1]; ++e)
+                    if (--npred[g.succ[e]] == 0)
+                        order.push_back(g.succ[e]);
+            }
+
+            if (order.size() != n)
+                throw std::logic_error("dag::make_rank: cycle detected");
+
+            g.rank.assign(n, 0);
+
+            for(auto it = order.rbegin(); it != order.rend(); ++it)
+            {
+                auto v = *it;
+                long m = 0;
+                for(auto e = g.first[v]; e != g.first[v+1]; ++e)
+                    m = std::max(m, g.rank[g.succ[e]]);
+                g.rank[v] = g.cost[v] + m;
+            }
+        }
+
+        // a name within a dot string: quote and backslash escaped...
+        //
+
+        void
+        show_label(std::ostream &out, std::string const &s)
+        {
+            for(auto c : s)
+            {
+                if (c == '"' || c == '\\')
+                    out << '\\';
+                out << c;
+            }
+        }
+    }
+
+    /////////// public functions...
+
+    Graph make_graph(SwitchMap const &sm, Nodes const &ns, TapMap const &tm,
+                     std::vector<script::line> br,
+                     script::shaping sh,
+                     std::vector<script::line> kvm,
+                     std::vector<script::line> img,
+                     std::vector<script::line> vms)
+    {
+        if (br.size() != sm.size() || sh.cmds.size() != sh.taps.size() || img.size() != ns.size() || vms.size() != ns.size())
+            throw std::logic_error("dag::make_graph: internal error");
+
+        Graph g;
+
+        auto n = sm.size() + sh.cmds.size() + kvm.size() + 2 * ns.size();
+
+        g.type.reserve(n);
+        g.name.reserve(n);
+        g.cmd.reserve(n);
+        g.cost.reserve(n);
+
+        // bridges: taps are numbered the same way script::make_bridges does,
+        // so that each tap can be mapped back to its switch...
+        //
+
+        std::vector<int> owner(1, -1);
+
+        size_t i = 0;
+        for(auto & s : sm)
+        {
+            auto nlink = get_num_links(s.second);
+
+            auto v = add_vertex(g, kind::bridge, s.first, std::move(br[i++]), 1 + nlink);
+
+            owner.insert(owner.end(), static_cast<size_t>(nlink), v);
+        }
+
+        auto check_tap = [&](int tap)
+        {
+            if (tap <= 0 || static_cast<size_t>(tap) >= owner.size())
+                throw std::logic_error("dag::make_graph: tap" + std::to_string(tap) + " out of range");
+        };
+
+        std::vector<std::pair<int,int>> edges;
+        std::vector<int> deps;
+
+        // link shaping: after the switches of its taps...
+        //
+
+        std::vector<int> shaper(owner.size(), -1);
+
+        for(size_t j = 0; j < sh.cmds.size(); ++j)
+        {
+            auto v = add_vertex(g, kind::shaping, "tc" + std::to_string(j), std::move(sh.cmds[j]),
+                                1 + static_cast<long>(sh.taps[j].size()) / 64);
+            deps.clear();
+
+            for(auto tap : sh.taps[j])
+            {
+                check_tap(tap);
+                deps.push_back(owner[tap]);
+                shaper[tap] = v;
+            }
+
+            std::sort(deps.begin(), deps.end());
+            deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+
+            for(auto d : deps)
+                edges.emplace_back(d, v);
+        }
+
+        // kvm setup...
+        //
+
+        std::vector<int> setup;
+
+        for(auto & k : kvm)
+            setup.push_back(add_vertex(g, kind::kvm, "kvm", std::move(k), 1));
+
+        // VMs...
+        //
+
+        i = 0;
+        for(auto & node : ns)
+        {
+            auto t = tm.find(node_name(node));
+            if (t == std::end(tm))
+                throw std::logic_error("dag::make_graph: internal error");
+
+            deps = setup;
+
+            if (!img[i].empty())
+                deps.push_back(add_vertex(g, kind::image, node_name(node), std::move(img[i]), 4));
+
+            auto v = add_vertex(g, kind::vm, node_name(node), std::move(vms[i++]),
+                                1 + static_cast<long>(t->second.size()));
+
+            for(auto tap : t->second)
+            {
+                check_tap(tap);
+                deps.push_back(owner[tap]);
+                if (shaper[tap] >= 0)
+                    deps.push_back(shaper[tap]);
+            }
+
+            std::sort(deps.begin(), deps.end());
+            deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+
+            for(auto d : deps)
+                edges.emplace_back(d, v);
+        }
+
+        make_csr(g, edges);
+        make_rank(g);
+
+        return g;
+    }
+
+
+    void show_dot(std::ostream &out, Graph const &g)
+    {
+        static const char * const kind_name[] = { "bridge", "shaping", "kvm", "image", "vm" };
+
+        out << "digraph topo {\n";
+
+        for(size_t v = 0; v < g.size(); ++v)
+        {
+            out << "    n" << v << " [label=\"" << kind_name[static_cast<int>(g.type[v])] << ' ';
+            show_label(out, g.name[v]);
+            out << "\\nrank " << g.rank[v] << "\"];\n";
+        }
+
+        for(size_t v = 0; v < g.size(); ++v)
+            for(auto e = g.first[v]; e != g.first[v+1]; ++e)
+                out << "    n" << v << " -> n" << g.succ[e] << ";\n";
+
+        out << "}" << std::endl;
+    }
+
+    } // namespace dag
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <network.hpp>
+#include <script.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace topo
+{
+    namespace dag
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // deployment graph: one vertex per command (bridge, shaping, kvm,
+        // image, vm). A VM depends on kvm, on the switches its taps belong
+        // to, on the shaping of its taps and on the creation of its overlay
+        // image, if any. A shaping command depends on the switches of the
+        // taps it shapes.
+        //
+        // Edges are stored in CSR form: the successors of v are
+        // succ[first[v]] ... succ[first[v+1]-1].
+        //
+
+        enum class kind
+        {
+            bridge,
+            shaping,
+            kvm,
+            image,
+            vm
+        };
+
+        struct Graph
+        {
+            std::vector<kind>           type;
+            std::vector<std::string>    name;
+            std::vector<script::line>   cmd;
+            std::vector<long>           cost;   // estimated cost (arbitrary units)
+            std::vector<long>           rank;   // critical path: max cost to a sink
+            std::vector<int>            npred;  // number of predecessors
+
+            std::vector<size_t>         first;
+            std::vector<int>            succ;
+
+            size_t size() const
+            {
+                return cmd.size();
+            }
+        };
+
+        // build the graph from the switch/tap maps and the commands generated
+        // by script::make_bridges, script::make_shaping, script::make_kvm,
+        // script::make_overlays and script::make_vms...
+        //
+
+        Graph make_graph(SwitchMap const &sm, Nodes const &ns, TapMap const &tm,
+                         std::vector<script::line> br,
+                         script::shaping sh,
+                         std::vector<script::line> kvm,
+                         std::vector<script::line> img,
+                         std::vector<script::line> vms);
+
+        // dump the graph in graphviz dot format...
+        //
+
+        void show_dot(std::ostream &out, Graph const &g);
+
+    } // namespace dag
+
+} // namespace topo
@@ -0,0 +1,256 @@
+#include <emitter.hpp>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace topo
+{
+    namespace emit {
+
+    ///////////////////////////////////////////////////////////////////////////
+    // output
+
+    output::output(int fd, size_t size)
+    : fd_(fd)
+    , buf_(size)
+    , len_(0)
+    {}
+
+    output::~output()
+    {
+        try
+        {
+            flush();
+        }
+        catch(...)
+        {}
+    }
+
+    void
+    output::write(const char *data, size_t len)
+    {
+        if (len <= buf_.size() - len_)
+        {
+            memcpy(&buf_[len_], data, len);
+            len_ += len;
+            return;
+        }
+
+        if (len < buf_.size())
+        {
+            flush();
+            memcpy(&buf_[0], data, len);
+            len_ = len;
+            return;
+        }
+
+        // too big to be buffered: out along with the pending data...
+        //
+
+        writev_(data, len);
+    }
+
+    void
+    output::flush()
+    {
+        writev_(nullptr, 0);
+    }
+
+    void
+    output::writev_(const char *data, size_t len)
+    {
+        iovec iov[2];
+        iov[0].iov_base = buf_.data();
+        iov[0].iov_len  = len_;
+        iov[1].iov_base = const_cast<char *>(data);
+        iov[1].iov_len  = len;
+
+        int first = 0;
+
+        while (iov[0].iov_len + iov[1].iov_len > 0)
+        {
+            auto n = ::writev(fd_, iov + first, 2 - first);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                len_ = 0;
+                throw std::runtime_error(std::string("emit: write: ") + strerror(errno));
+            }
+
+            for(int i = first; i < 2 && n > 0; ++i)
+            {
+                auto m = std::min(static_cast<size_t>(n), iov[i].iov_len);
+                iov[i].iov_base = static_cast<char *>(iov[i].iov_base) + m;
+                iov[i].iov_len -= m;
+                n -= static_cast<ssize_t>(m);
+            }
+
+            if (iov[0].iov_len == 0)
+                first = 1;
+        }
+
+        len_ = 0;
+    }
+
+    namespace
+    {
+        ///////////////////////////////////////////////////////////////////////
+        // sh script
+
+        class sh_emitter : public emitter
+        {
+        public:
+            sh_emitter(int fd)
+            : out_(fd)
+            {}
+
+            void section(std::string const &, std::string const &comment)
+            {
+                out_.write("\n# ", 3);
+                out_.write(comment);
+                out_.put('\n');
+            }
+
+            void command(script::line const &cmd)
+            {
+                out_.write("sh ", 3);
+                out_.write(cmd);
+                out_.put('\n');
+            }
+
+            void flush()
+            {
+                out_.flush();
+            }
+
+        private:
+            output out_;
+        };
+
+        ///////////////////////////////////////////////////////////////////////
+        // JSON lines
+
+        class json_emitter : public emitter
+        {
+        public:
+            json_emitter(int fd)
+            : out_(fd)
+            {}
+
+            void section(std::string const &phase, std::string const &)
+            {
+                phase_ = phase;
+            }
+
+            void command(script::line const &cmd)
+            {
+                out_.write("{\"phase\":\"", 10);
+                escape(phase_);
+                out_.write("\",\"cmd\":\"sh ", 12);
+                escape(cmd);
+                out_.write("\"}\n", 3);
+            }
+
+            void flush()
+            {
+                out_.flush();
+            }
+
+        private:
+            void escape(std::string const &s)
+            {
+                static const char hex[] = "0123456789abcdef";
+
+                for(auto c : s)
+                {
+                    switch(c)
+                    {
+                    case '"':  out_.write("\\\"", 2); break;
+                    case '\\': out_.write("\\\\", 2); break;
+                    case '\n': out_.write("\\n", 2);  break;
+                    case '\t': out_.write("\\t", 2);  break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20)
+                        {
+                            char u[6] = { '\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf] };
+                            out_.write(u, sizeof(u));
+                        }
+                        else
+                            out_.put(c);
+                    }
+                }
+            }
+
+            output out_;
+            std::string phase_;
+        };
+
+        ///////////////////////////////////////////////////////////////////////
+        // binary plan
+
+        class bin_emitter : public emitter
+        {
+        public:
+            bin_emitter(int fd)
+            : out_(fd)
+            {
+                out_.write("TPLN\x01", 5);
+            }
+
+            void section(std::string const &phase, std::string const &)
+            {
+                record(0, phase);
+            }
+
+            void command(script::line const &cmd)
+            {
+                record(1, cmd);
+            }
+
+            void flush()
+            {
+                out_.flush();
+            }
+
+        private:
+            void record(uint8_t kind, std::string const &payload)
+            {
+                auto len = static_cast<uint32_t>(payload.size());
+
+                char hdr[5] = { static_cast<char>(kind),
+                                static_cast<char>(len & 0xff),
+                                static_cast<char>((len >> 8) & 0xff),
+                                static_cast<char>((len >> 16) & 0xff),
+                                static_cast<char>((len >> 24) & 0xff) };
+
+                out_.write(hdr, sizeof(hdr));
+                out_.write(payload);
+            }
+
+            output out_;
+        };
+    }
+
+    /////////// public functions...
+
+    std::unique_ptr<emitter> make_emitter(std::string const &format, int fd)
+    {
+        if (format == "sh")
+            return std::unique_ptr<emitter>(new sh_emitter(fd));
+        if (format == "json")
+            return std::unique_ptr<emitter>(new json_emitter(fd));
+        if (format == "bin")
+            return std::unique_ptr<emitter>(new bin_emitter(fd));
+
+        throw std::runtime_error("emit: unknown format " + format);
+    }
+
+    } // namespace emit
+}
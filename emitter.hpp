@@ -0,0 +1,130 @@
+#pragma once
+
+#include <script.hpp>
+
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace topo
+{
+    namespace emit
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // buffered output on a file descriptor: lines are accumulated in a
+        // large buffer and written out with writev when it fills up.
+        //
+
+        class output
+        {
+        public:
+            output(int fd, size_t size = 1 << 18);
+            ~output();
+
+            output(output const &) = delete;
+            output& operator=(output const &) = delete;
+
+            void write(const char *data, size_t len);
+
+            void write(std::string const &s)
+            {
+                write(s.data(), s.size());
+            }
+
+            void put(char c)
+            {
+                if (len_ == buf_.size())
+                    flush();
+                buf_[len_++] = c;
+            }
+
+            void flush();
+
+        private:
+            void writev_(const char *data, size_t len);
+
+            int fd_;
+            std::vector<char> buf_;
+            size_t len_;
+        };
+
+        // an output as a std::streambuf (std::ostream on a descriptor,
+        // flushed by std::flush/std::endl)...
+        //
+
+        class output_buf : public std::streambuf
+        {
+        public:
+            explicit output_buf(output &out)
+            : out_(out)
+            {}
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if (!traits_type::eq_int_type(c, traits_type::eof()))
+                    out_.put(traits_type::to_char_type(c));
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char *s, std::streamsize n) override
+            {
+                out_.write(s, static_cast<size_t>(n));
+                return n;
+            }
+
+            int sync() override
+            {
+                out_.flush();
+                return 0;
+            }
+
+        private:
+            output &out_;
+        };
+
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // emitter: the plan is a sequence of sections (bridges, kvm, vms),
+        // each with its own commands.
+        //
+        // formats:
+        //
+        //  sh      the shell script (default)
+        //  json    one JSON object per line: {"phase":"...","cmd":"sh ..."},
+        //          cmd being the full command line, as in the script
+        //  bin     "TPLN" + version byte, then records:
+        //          u8 kind (0 = section, 1 = command), u32 length (little
+        //          endian), payload (phase name, or the arguments of sh for
+        //          a command)
+        //
+
+        class emitter
+        {
+        public:
+            virtual ~emitter() {}
+
+            virtual void section(std::string const &phase, std::string const &comment) = 0;
+
+            virtual void command(script::line const &cmd) = 0;
+
+            virtual void flush() = 0;
+
+            // empty lines (nothing to do) are skipped...
+            //
+
+            void commands(std::vector<script::line> const &cmds)
+            {
+                for(auto & c : cmds)
+                    if (!c.empty())
+                        command(c);
+            }
+        };
+
+        std::unique_ptr<emitter> make_emitter(std::string const &format, int fd = 1);
+
+    } // namespace emit
+
+} // namespace topo
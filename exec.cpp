@@ -0,0 +1,509 @@
+#include <exec.hpp>
+#include <admission.hpp>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <spawn.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+
+#include <print.hpp>
+
+extern char **environ;
+
+namespace topo
+{
+    namespace exec {
+
+    namespace
+    {
+        typedef std::chrono::steady_clock clock_type;
+
+        int
+        exit_code(int status)
+        {
+            if (WIFEXITED(status))
+                return WEXITSTATUS(status);
+            if (WIFSIGNALED(status))
+                return 128 + WTERMSIG(status);
+            return 255;
+        }
+
+        void
+        report(std::string const &tag, result const &r)
+        {
+            more::print(std::cerr, "exec: [%1] status %2 %3 us%4: %5\n",
+                        tag, r.status, r.duration.count(), r.running ? " (running)" : "", r.cmd);
+        }
+
+        // --admission: the VM launches wait for the controller (not in
+        // dry-run, where nothing is launched)...
+        //
+
+        std::unique_ptr<admission::controller>
+        make_admission(context const &ctx)
+        {
+            if (!ctx.admission || ctx.dry_run)
+                return std::unique_ptr<admission::controller>();
+            return std::unique_ptr<admission::controller>(new admission::controller(ctx.proc));
+        }
+
+        void
+        report(admission::controller const &ac)
+        {
+            more::print(std::cerr, "exec: admission: %1 launches, %2 waits, %3 ms held, rate %4/s%5\n",
+                        ac.admitted(), ac.waits(),
+                        std::chrono::duration_cast<std::chrono::milliseconds>(ac.held()).count(),
+                        ac.rate(), ac.congested() ? " (congested)" : "");
+        }
+
+        //
+        // set of commands in flight: spawn through the shell (the same way
+        // the generated script would run them) and reap them one at a time.
+        //
+        // A VM launch is complete when it exits (a boot failure) or when it
+        // is still running after the grace period: it holds a job until
+        // then, and is left running.
+        //
+
+        class pool
+        {
+            struct running
+            {
+                size_t id;
+                script::line const *cmd;
+                clock_type::time_point start;
+            };
+
+        public:
+            pool(context const &ctx)
+            : shell_(ctx.shell)
+            , dry_run_(ctx.dry_run)
+            , grace_(std::chrono::milliseconds(std::max(ctx.launch_grace, 0)))
+            {}
+
+            // commands not completed yet...
+
+            size_t size() const
+            {
+                return inflight_.size() + dry_.size();
+            }
+
+            // a launch is the leader of a new process group, its pid stored
+            // in *lpid...
+
+            bool spawn(size_t id, script::line const &cmd, bool launch = false, pid_t *lpid = nullptr)
+            {
+                if (dry_run_)
+                {
+                    std::cout << "sh " << cmd << '\n';
+                    dry_.push_back(std::make_pair(id, result{cmd, 0, std::chrono::microseconds(0), false}));
+                    return true;
+                }
+
+                std::string sh_cmd = "sh " + cmd;
+
+                char *argv[] = { const_cast<char *>(shell_.c_str()),
+                                 const_cast<char *>("-c"),
+                                 const_cast<char *>(sh_cmd.c_str()),
+                                 nullptr };
+
+                auto start = clock_type::now();
+                pid_t pid;
+
+                posix_spawnattr_t attr;
+                posix_spawnattr_init(&attr);
+
+                if (launch)
+                {
+                    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+                    posix_spawnattr_setpgroup(&attr, 0);
+                }
+
+                int err = posix_spawn(&pid, shell_.c_str(), nullptr, &attr, argv, environ);
+
+                posix_spawnattr_destroy(&attr);
+
+                if (err != 0)
+                {
+                    std::cerr << "exec: " << shell_ << ": " << strerror(err) << std::endl;
+                    return false;
+                }
+
+                inflight_[pid] = running{id, &cmd, start};
+
+                if (launch)
+                    launches_.push_back(pid);
+
+                if (lpid)
+                    *lpid = pid;
+                return true;
+            }
+
+            // wait for the completion of one of the commands in flight, at
+            // most until 'until': false if none completed by then...
+            //
+
+            bool wait(std::pair<size_t, result> &ret, clock_type::time_point until = clock_type::time_point::max())
+            {
+                if (!dry_.empty())
+                {
+                    ret = std::move(dry_.front());
+                    dry_.pop_front();
+                    return true;
+                }
+
+                bool bounded = until != clock_type::time_point::max();
+
+                for(;;)
+                {
+                    // the oldest launch in flight has the first deadline...
+
+                    while (!launches_.empty() && inflight_.find(launches_.front()) == std::end(inflight_))
+                        launches_.pop_front();
+
+                    int status;
+                    pid_t pid = waitpid(-1, &status, launches_.empty() && !bounded ? 0 : WNOHANG);
+                    if (pid < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        throw std::runtime_error(std::string("exec: waitpid: ") + strerror(errno));
+                    }
+
+                    if (pid == 0)
+                    {
+                        auto now = clock_type::now();
+                        auto next = until;
+
+                        if (!launches_.empty())
+                        {
+                            auto it = inflight_.find(launches_.front());
+
+                            if (now >= it->second.start + grace_)
+                            {
+                                // still running: launched, no longer followed...
+
+                                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - it->second.start);
+                                ret = std::make_pair(it->second.id, result{*it->second.cmd, 0, elapsed, true});
+
+                                launches_.pop_front();
+                                inflight_.erase(it);
+                                return true;
+                            }
+
+                            next = std::min(next, it->second.start + grace_);
+                        }
+
+                        if (now >= until)
+                            return false;
+
+                        std::this_thread::sleep_for(std::min<clock_type::duration>(next - now, std::chrono::milliseconds(10)));
+                        continue;
+                    }
+
+                    auto it = inflight_.find(pid);
+                    if (it == std::end(inflight_))
+                        continue;
+
+                    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - it->second.start);
+
+                    ret = std::make_pair(it->second.id, result{*it->second.cmd, exit_code(status), elapsed, false});
+
+                    inflight_.erase(it);
+                    return true;
+                }
+            }
+
+        private:
+            std::string shell_;
+            bool dry_run_;
+            clock_type::duration grace_;
+            std::map<pid_t, running> inflight_;
+            std::deque<pid_t> launches_;
+            std::deque<std::pair<size_t, result>> dry_;
+        };
+
+        // run a single phase with at most 'jobs' commands in flight,
+        // return false if any command failed...
+        //
+
+        bool
+        run_phase(Phase const &phase, int jobs, context const &ctx, std::vector<result> &out,
+                  admission::controller *ac, Launches *launched)
+        {
+            auto & cmds = phase.second;
+
+            pool p(ctx);
+
+            size_t next = 0;
+            bool ok = true;
+
+            while (next < cmds.size() || p.size() > 0)
+            {
+                // fill the pool, unless a failure has been seen; a launch
+                // not admitted yet is retried after the wait below...
+                //
+
+                auto admit_at = clock_type::time_point::max();
+
+                while (ok && next < cmds.size() && static_cast<int>(p.size()) < jobs)
+                {
+                    if (cmds[next].empty())     // nothing to do...
+                    {
+                        out.push_back(result{cmds[next], 0, std::chrono::microseconds(0), false});
+                        next++;
+                        continue;
+                    }
+
+                    if (ac)
+                    {
+                        auto d = ac->admit(clock_type::now());
+                        if (d != clock_type::duration::zero())
+                        {
+                            admit_at = clock_type::now() + d;
+                            break;
+                        }
+                    }
+
+                    if (launched)
+                        (*launched)[next].start = std::chrono::system_clock::now();
+
+                    if (!p.spawn(next, cmds[next], phase.first == "vms", launched ? &(*launched)[next].pid : nullptr))
+                    {
+                        out.push_back(result{cmds[next], 127, std::chrono::microseconds(0), false});
+                        report(phase.first, out.back());
+                        ok = false;
+                        break;
+                    }
+                    next++;
+                }
+
+                if (p.size() == 0)
+                {
+                    if (admit_at == clock_type::time_point::max())
+                        break;
+                    std::this_thread::sleep_until(admit_at);
+                    continue;
+                }
+
+                // collect the commands completed meanwhile (a failed launch
+                // stops the next ones)...
+
+                std::pair<size_t, result> r;
+                if (!p.wait(r, admit_at))
+                    continue;
+
+                out.push_back(std::move(r.second));
+
+                if (out.back().status != 0)
+                    ok = false;
+
+                if (out.back().status != 0 || ctx.verbose)
+                    report(phase.first, out.back());
+            }
+
+            return ok;
+        }
+    }
+
+    /////////// public functions...
+
+    int run(Plan const &plan, context const &ctx, Launches *launched)
+    {
+        auto jobs = std::max(ctx.jobs, 1);
+        auto ac = make_admission(ctx);
+
+        for(auto & phase : plan)
+        {
+            std::vector<result> res;
+            res.reserve(phase.second.size());
+
+            auto start = clock_type::now();
+
+            bool vms = phase.first == "vms";
+
+            if (vms && launched)
+                launched->assign(phase.second.size(), launch{std::chrono::system_clock::time_point(), 0});
+
+            bool ok = run_phase(phase, jobs, ctx, res, vms ? ac.get() : nullptr, vms ? launched : nullptr);
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - start);
+
+            size_t failed = 0;
+            for(auto & r : res)
+                failed += r.status != 0;
+
+            more::print(std::cerr, "exec: phase %1: %2/%3 commands run, %4 failed, %5 ms\n",
+                        phase.first, res.size(), phase.second.size(), failed, elapsed.count());
+
+            if (ac && phase.first == "vms")
+                report(*ac);
+
+            if (!ok)
+            {
+                std::cerr << "exec: phase " << phase.first << " failed, aborting." << std::endl;
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+
+    int run(dag::Graph const &g, context const &ctx, Launches *launched)
+    {
+        static const char * const kind_name[] = { "bridge", "shaping", "kvm", "image", "vm" };
+
+        auto jobs = std::max(ctx.jobs, 1);
+        auto ac = make_admission(ctx);
+
+        // ready queue, ordered by critical path (longest first)...
+        //
+
+        typedef std::pair<long, int> ready_type;    // rank, -vertex
+
+        std::priority_queue<ready_type> ready;
+
+        std::vector<int> npred(g.npred);
+
+        for(size_t v = 0; v < g.size(); ++v)
+            if (npred[v] == 0)
+                ready.emplace(g.rank[v], -static_cast<int>(v));
+
+        // release the successors of a completed command...
+        //
+
+        auto release = [&](size_t v)
+        {
+            for(auto e = g.first[v]; e != g.first[v+1]; ++e)
+            {
+                auto s = g.succ[e];
+                if (--npred[s] == 0)
+                    ready.emplace(g.rank[s], -s);
+            }
+        };
+
+        // ordinal of the vm vertices, for the launch times...
+        //
+
+        std::vector<size_t> vm_index(launched ? g.size() : 0);
+
+        if (launched)
+        {
+            size_t n = 0;
+            for(size_t v = 0; v < g.size(); ++v)
+                if (g.type[v] == dag::kind::vm)
+                    vm_index[v] = n++;
+            launched->assign(n, launch{std::chrono::system_clock::time_point(), 0});
+        }
+
+        pool p(ctx);
+
+        auto start = clock_type::now();
+
+        size_t done = 0, failed = 0;
+        bool ok = true;
+
+        while (!ready.empty() || p.size() > 0)
+        {
+            auto admit_at = clock_type::time_point::max();
+
+            while (!ready.empty() && static_cast<int>(p.size()) < jobs)
+            {
+                auto v = static_cast<size_t>(-ready.top().second);
+                auto vm = g.type[v] == dag::kind::vm;
+
+                // a vm not admitted yet stays ready until the wait below...
+
+                if (ac && vm && !g.cmd[v].empty())
+                {
+                    auto d = ac->admit(clock_type::now());
+                    if (d != clock_type::duration::zero())
+                    {
+                        admit_at = clock_type::now() + d;
+                        break;
+                    }
+                }
+
+                ready.pop();
+
+                if (g.cmd[v].empty())           // nothing to do...
+                {
+                    done++;
+                    release(v);
+                    continue;
+                }
+
+                if (launched && vm)
+                    (*launched)[vm_index[v]].start = std::chrono::system_clock::now();
+
+                if (!p.spawn(v, g.cmd[v], vm, launched && vm ? &(*launched)[vm_index[v]].pid : nullptr))
+                {
+                    report(kind_name[static_cast<int>(g.type[v])], result{g.cmd[v], 127, std::chrono::microseconds(0), false});
+                    done++;
+                    failed++;
+                    ok = false;
+                }
+            }
+
+            if (p.size() == 0)
+            {
+                if (admit_at == clock_type::time_point::max())
+                    break;
+                std::this_thread::sleep_until(admit_at);
+                continue;
+            }
+
+            std::pair<size_t, result> r;
+            if (!p.wait(r, admit_at))
+                continue;
+
+            auto v = r.first;
+
+            done++;
+
+            if (r.second.status != 0 || ctx.verbose)
+                report(kind_name[static_cast<int>(g.type[v])], r.second);
+
+            // a failure cancels the successors of the command (and theirs),
+            // the independent commands are still run...
+
+            if (r.second.status != 0)
+            {
+                failed++;
+                ok = false;
+                continue;
+            }
+
+            release(v);
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - start);
+
+        more::print(std::cerr, "exec: graph: %1/%2 commands run, %3 failed, %4 cancelled, %5 ms\n",
+                    done, g.size(), failed, g.size() - done, elapsed.count());
+
+        if (ac)
+            report(*ac);
+
+        if (!ok)
+        {
+            std::cerr << "exec: graph execution failed, aborting." << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    } // namespace exec
+}
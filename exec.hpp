@@ -0,0 +1,74 @@
+#pragma once
+
+#include <script.hpp>
+#include <dag.hpp>
+#include <context.hpp>
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace topo
+{
+    namespace exec
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // a plan is an ordered list of phases (bridges, kvm, vms...).
+        // Commands within a phase run concurrently, phases are barriers.
+        //
+
+        typedef std::pair<std::string, std::vector<script::line>> Phase;
+
+        typedef std::vector<Phase> Plan;
+
+        struct result
+        {
+            script::line cmd;
+            int status;                             // exit code, 128+signal if killed
+            std::chrono::microseconds duration;
+            bool running;                           // VM launch still up after the grace period
+        };
+
+        // each VM launch, in the order of the VM commands (phase vms, vm
+        // vertices): its spawn time, the epoch of the boot monitor, and its
+        // pid. A VM is spawned as the leader of its own process group (the
+        // startmv.sh and qemu processes), stopped as a whole by teardown.
+        // The VMs not launched are left to the epoch, with pid 0...
+        //
+
+        struct launch
+        {
+            std::chrono::system_clock::time_point start;
+            pid_t pid;
+        };
+
+        typedef std::vector<launch> Launches;
+
+        // run the plan with at most ctx.jobs commands in flight.
+        // Stops at the first phase that has a failing command (in-flight
+        // commands are waited for, pending ones are not started).
+        //
+        // The VM launches (phase vms) are followed for ctx.launch_grace ms,
+        // holding a job: an exit in the meantime is its status, a VM still
+        // running afterwards is launched and releases its job.
+        //
+        // returns 0 on success, 1 otherwise.
+
+        int run(Plan const &plan, context const &ctx, Launches *launched = nullptr);
+
+        // run the dependency graph: a command is started as soon as all its
+        // predecessors have completed, the ready ones by critical path first.
+        // A failing command cancels its descendants only: whatever does not
+        // depend on it is still run (e.g. the VMs of the other overlays),
+        // and the run fails.
+        //
+
+        int run(dag::Graph const &g, context const &ctx, Launches *launched = nullptr);
+
+    } // namespace exec
+
+} // namespace topo
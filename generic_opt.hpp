@@ -84,6 +84,20 @@ namespace generic {
         return in;
     }
     
+    // more::format: append the option without an ostream (found by ADL)...
+    //
+
+    template <typename Tp>
+    inline void
+    append_to(std::string &out, option<Tp> const &that)
+    {
+        out += that.opt;
+        for(auto const & x : that.args) {
+            out += ' ';
+            out += x;
+        }
+    }
+
     template <typename Tp>
     inline std::string
     show(const option<Tp> &opt, const char * n = nullptr)
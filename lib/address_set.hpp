@@ -0,0 +1,340 @@
+#pragma once
+
+#include <netaddress.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace net {
+
+    ///////////////////////////////////////////////////////////////////////////
+    //
+    // address_set, address_map: open addressing with linear probing over a
+    // flat array of slots, plus one control byte per slot (0 = empty,
+    // otherwise 7 bits of the hash, to skip most of the key compares).
+    // Capacity is a power of two, the load factor at most 3/4; erase
+    // shifts the following entries back (no tombstones).
+    //
+    // Iterators and references are invalidated by insert and erase.
+    //
+
+    namespace detail {
+
+        inline const address &
+        key_of(const address &a)
+        {
+            return a;
+        }
+
+        template <typename T>
+        inline const address &
+        key_of(const std::pair<address, T> &p)
+        {
+            return p.first;
+        }
+
+        template <typename Slot, typename Hash = address_hash>
+        class flat_table
+        {
+        public:
+            typedef Slot value_type;
+
+            template <typename V, typename Table>
+            class basic_iterator : public std::iterator<std::forward_iterator_tag, V>
+            {
+                friend class flat_table;
+
+                template <typename, typename> friend class basic_iterator;
+
+            public:
+                basic_iterator()
+                : t_(nullptr), i_(0)
+                {}
+
+                // iterator -> const_iterator
+                //
+
+                template <typename V2, typename Table2>
+                basic_iterator(const basic_iterator<V2, Table2> &other)
+                : t_(other.t_), i_(other.i_)
+                {}
+
+                V & operator*() const  { return t_->slots_[i_]; }
+                V * operator->() const { return &t_->slots_[i_]; }
+
+                basic_iterator &
+                operator++()
+                {
+                    i_ = t_->next(i_ + 1);
+                    return *this;
+                }
+
+                basic_iterator
+                operator++(int)
+                {
+                    auto ret = *this;
+                    ++*this;
+                    return ret;
+                }
+
+                bool operator==(const basic_iterator &other) const { return i_ == other.i_; }
+                bool operator!=(const basic_iterator &other) const { return i_ != other.i_; }
+
+            private:
+                basic_iterator(Table *t, size_t i)
+                : t_(t), i_(i)
+                {}
+
+                Table *t_;
+                size_t i_;
+            };
+
+            typedef basic_iterator<Slot, flat_table> iterator;
+            typedef basic_iterator<const Slot, const flat_table> const_iterator;
+
+            // never empty: at least 16 slots...
+            //
+
+            explicit flat_table(size_t n = 0)
+            : ctrl_(), slots_(), size_(0)
+            {
+                reserve(n);
+            }
+
+            size_t size() const  { return size_; }
+            bool empty() const   { return size_ == 0; }
+
+            iterator begin()              { return iterator(this, next(0)); }
+            iterator end()                { return iterator(this, ctrl_.size()); }
+            const_iterator begin() const  { return const_iterator(this, next(0)); }
+            const_iterator end() const    { return const_iterator(this, ctrl_.size()); }
+
+            void
+            clear()
+            {
+                std::fill(ctrl_.begin(), ctrl_.end(), 0);
+                std::fill(slots_.begin(), slots_.end(), Slot());
+                size_ = 0;
+            }
+
+            void
+            reserve(size_t n)
+            {
+                size_t cap = 16;
+                while (cap * 3 / 4 < n)
+                    cap *= 2;
+                if (cap > ctrl_.size())
+                    rehash(cap);
+            }
+
+            iterator
+            find(const address &key)
+            {
+                auto r = probe(key, Hash()(key));
+                return r.second ? iterator(this, r.first) : end();
+            }
+
+            const_iterator
+            find(const address &key) const
+            {
+                auto r = probe(key, Hash()(key));
+                return r.second ? const_iterator(this, r.first) : end();
+            }
+
+            size_t
+            count(const address &key) const
+            {
+                return probe(key, Hash()(key)).second;
+            }
+
+            std::pair<iterator, bool>
+            insert(Slot s)
+            {
+                if (size_ + 1 > ctrl_.size() * 3 / 4)
+                    rehash(ctrl_.size() * 2);
+
+                auto h = Hash()(key_of(s));
+                auto r = probe(key_of(s), h);
+
+                if (r.second)
+                    return std::make_pair(iterator(this, r.first), false);
+
+                ctrl_[r.first] = tag(h);
+                slots_[r.first] = std::move(s);
+                size_++;
+
+                return std::make_pair(iterator(this, r.first), true);
+            }
+
+            size_t
+            erase(const address &key)
+            {
+                auto r = probe(key, Hash()(key));
+                if (!r.second)
+                    return 0;
+
+                // backward shift: move back the entries of the cluster that
+                // would not be found across the hole...
+                //
+
+                auto mask = ctrl_.size() - 1;
+                auto i = r.first;
+
+                for(auto j = (i + 1) & mask; ctrl_[j] != 0; j = (j + 1) & mask)
+                {
+                    auto ideal = Hash()(key_of(slots_[j])) & mask;
+
+                    if (((j - ideal) & mask) >= ((j - i) & mask))
+                    {
+                        ctrl_[i] = ctrl_[j];
+                        slots_[i] = std::move(slots_[j]);
+                        i = j;
+                    }
+                }
+
+                ctrl_[i] = 0;
+                slots_[i] = Slot();
+                size_--;
+                return 1;
+            }
+
+        private:
+            static uint8_t
+            tag(size_t h)
+            {
+                return static_cast<uint8_t>(0x80 | (h >> (sizeof(size_t) * 8 - 7)));
+            }
+
+            // the slot of key, or the empty slot where it goes...
+            //
+
+            std::pair<size_t, bool>
+            probe(const address &key, size_t h) const
+            {
+                auto mask = ctrl_.size() - 1;
+                auto t = tag(h);
+
+                for(auto i = h & mask; ; i = (i + 1) & mask)
+                {
+                    if (ctrl_[i] == 0)
+                        return std::make_pair(i, false);
+                    if (ctrl_[i] == t && key_of(slots_[i]) == key)
+                        return std::make_pair(i, true);
+                }
+            }
+
+            size_t
+            next(size_t i) const
+            {
+                while (i < ctrl_.size() && ctrl_[i] == 0)
+                    ++i;
+                return i;
+            }
+
+            void
+            rehash(size_t cap)
+            {
+                std::vector<uint8_t> ctrl(cap, 0);
+                std::vector<Slot> slots(cap);
+
+                ctrl_.swap(ctrl);
+                slots_.swap(slots);
+
+                for(size_t i = 0; i < ctrl.size(); ++i)
+                {
+                    if (ctrl[i] == 0)
+                        continue;
+
+                    auto r = probe(key_of(slots[i]), Hash()(key_of(slots[i])));
+                    ctrl_[r.first] = ctrl[i];
+                    slots_[r.first] = std::move(slots[i]);
+                }
+            }
+
+            std::vector<uint8_t> ctrl_;
+            std::vector<Slot> slots_;
+            size_t size_;
+        };
+
+    } // namespace detail
+
+
+    class address_set : public detail::flat_table<address>
+    {
+    public:
+        typedef detail::flat_table<address>::const_iterator iterator;
+
+        explicit address_set(size_t n = 0)
+        : detail::flat_table<address>(n)
+        {}
+
+        iterator begin() const  { return detail::flat_table<address>::begin(); }
+        iterator end() const    { return detail::flat_table<address>::end(); }
+
+        iterator find(const address &key) const
+        {
+            return detail::flat_table<address>::find(key);
+        }
+
+        std::pair<iterator, bool> insert(const address &key)
+        {
+            auto r = detail::flat_table<address>::insert(key);
+            return std::make_pair(iterator(r.first), r.second);
+        }
+
+        bool contains(const address &key) const
+        {
+            return count(key) != 0;
+        }
+    };
+
+
+    // the key of a value must not be changed through an iterator...
+    //
+
+    template <typename T>
+    class address_map : public detail::flat_table<std::pair<address, T>>
+    {
+        typedef detail::flat_table<std::pair<address, T>> base;
+
+    public:
+        typedef address key_type;
+        typedef T mapped_type;
+
+        explicit address_map(size_t n = 0)
+        : base(n)
+        {}
+
+        T &
+        operator[](const address &key)
+        {
+            auto it = base::find(key);
+            if (it != base::end())
+                return it->second;
+            return base::insert(std::make_pair(key, T())).first->second;
+        }
+
+        T &
+        at(const address &key)
+        {
+            auto it = base::find(key);
+            if (it == base::end())
+                throw std::out_of_range("net::address_map::at");
+            return it->second;
+        }
+
+        const T &
+        at(const address &key) const
+        {
+            auto it = base::find(key);
+            if (it == base::end())
+                throw std::out_of_range("net::address_map::at");
+            return it->second;
+        }
+    };
+
+} // namespace net
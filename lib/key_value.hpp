@@ -212,6 +212,32 @@ namespace more {
             { return TYPE(); }
         };
 
+        // the values of a key_value_pack: one base class per key, so that
+        // the value of a key is found by a derived-to-base conversion,
+        // without recursing over the pack.
+        //
+        template <typename P> struct slot;
+        template <typename KEY, typename TYPE>
+        struct slot<std::pair<KEY, TYPE>>
+        {
+            slot()
+            : value(get_default<KEY, TYPE, KEY::has_default>::value())
+            {}
+
+            TYPE value;
+        };
+
+        template <typename ...P>
+        struct slots : slot<P>...
+        {};
+
+        template <typename KEY, typename TYPE>
+        inline TYPE &
+        value_of(slot<std::pair<KEY, TYPE>> &s)
+        {
+            return s.value;
+        }
+
         // detail::tuple_helper<sizeof...(Ti)>::parse_lexeme(*this, tup) &&
         //
         template <size_t N>
@@ -859,27 +885,17 @@ namespace more {
     public:
 
         typedef more::type::typemap<typename T0::type, typename Ti::type...>    map_type;
-        typedef typename T0::type::first_type                                   key_type;
-        typedef typename T0::type::second_type                                  value_type;
 
-        typedef key_value_pack<Ti...>                                           parser_type;
-
-        parser_type  m_parser;
-        key_type     m_key;
-        value_type   m_value;
+        details::slots<typename T0::type, typename Ti::type...> m_value;
 
         key_value_pack()
-        : m_parser()
-        , m_key()
-        , m_value(details::get_default<key_type, value_type, key_type::has_default>::value()) 
+        : m_value()
         { }
 
 
         key_value_pack(const char *name, 
                          const parser_options &mode = std::make_tuple(false, '=', '#', "pack")) 
-        : m_parser()
-        , m_key()
-        , m_value(details::get_default<key_type, value_type, key_type::has_default>::value()) 
+        : m_value()
         {
             if(!this->load(name, mode))
                 throw std::runtime_error("key_value_pack");
@@ -895,7 +911,7 @@ namespace more {
         typename std::add_lvalue_reference<typename more::type::get<map_type, Key>::type>::type
         get() 
         { 
-            return get_<Key>(std::integral_constant<int, more::type::index_of<map_type, Key>::value>()); 
+            return details::value_of<Key>(m_value); 
         }
 
         template <typename Key>
@@ -903,56 +919,28 @@ namespace more {
         typename std::add_const<typename more::type::get<map_type, Key>::type>::type>::type
         get() const
         { 
-            return const_cast<key_value_pack *>(this)->get_<Key>(std::integral_constant<int, more::type::index_of<map_type, Key>::value>()); 
-        }
-
-        template <typename Key, int N>
-        typename std::add_lvalue_reference<typename more::type::get<map_type, Key>::type>::type
-        get_(std::integral_constant<int,N>) 
-        { 
-            return m_parser.template get_<Key>(std::integral_constant<int, N-1>()); 
-        }
-
-        template <typename Key>
-        typename std::add_lvalue_reference<value_type>::type
-        get_(std::integral_constant<int,0>) 
-        { 
-            return m_value; 
+            return details::value_of<Key>(const_cast<key_value_pack *>(this)->m_value); 
         }
 
     public:
 
-        // run-time parser 
+        // run-time parser: the key is looked up in the table of the key
+        // names, the value parsed by the function at the same index...
         //
         
         template <typename CharT, typename Traits>
         bool parse(std::basic_istream<CharT, Traits> &in, const std::string &key, 
                    const parser_options &mode, lexer<CharT, Traits> &lex)
         { 
-            return parse_(in, key, *this, mode, lex); 
-        }
+            typedef bool (*parse_fun)(key_value_pack &, std::basic_istream<CharT, Traits> &, 
+                                      const parser_options &, lexer<CharT, Traits> &);
 
-        template <typename CharT, typename Traits, typename _T0, typename ..._Ti>
-        static bool parse_(std::basic_istream<CharT, Traits> &in, const std::string &key, key_value_pack<_T0, _Ti...> &that, 
-                           const parser_options &mode, lexer<CharT, Traits> &lex)
-        {
-            if (key == _T0::type::first_type::str()) {
+            static const parse_fun parsers[] = { &parse_<T0, CharT, Traits>, &parse_<Ti, CharT, Traits>... };
 
-                if (!lex.log_ret(lex.parse_lexeme(that.m_value)).first || in.fail()) {
+            auto i = index_of(key);
+            if (i < sizeof...(Ti) + 1)
+                return parsers[i](*this, in, mode, lex);
 
-                    std::clog << std::get<target_name>(mode) << ": parse error: key[" << _T0::type::first_type::str() 
-                    << "] unexpected argument at line " << details::line_number(in) << std::endl;
-                    return false;
-                }
-                return true;
-            }
-            return parse_(in, key, that.m_parser, mode, lex);
-        }
-
-        template <typename CharT, typename Traits>
-        static bool parse_(std::basic_istream<CharT, Traits> &in, const std::string &key, 
-                           key_value_pack<> &, const parser_options &mode, lexer<CharT, Traits>&)
-        {
             // unknown key-value...
             //
             
@@ -967,25 +955,38 @@ namespace more {
             return true;
         }
 
+        template <typename Key, typename CharT, typename Traits>
+        static bool parse_(key_value_pack &that, std::basic_istream<CharT, Traits> &in, 
+                           const parser_options &mode, lexer<CharT, Traits> &lex)
+        {
+            if (!lex.log_ret(lex.parse_lexeme(details::value_of<Key>(that.m_value))).first || in.fail()) {
+
+                std::clog << std::get<target_name>(mode) << ": parse error: key[" << Key::str() 
+                << "] unexpected argument at line " << details::line_number(in) << std::endl;
+                return false;
+            }
+            return true;
+        }
+
         // predicate: has_key 
         //
 
-        bool has_key(const std::string &key) 
+        bool has_key(const std::string &key) const
         {
-            return has_key_(key, *this);
+            return index_of(key) < sizeof...(Ti) + 1;
         }
 
-        template <typename _T0, typename ..._Ti>
-        static bool has_key_(const std::string &key, key_value_pack<_T0, _Ti...> &that)
+        static size_t index_of(const std::string &key)
         {
-            if (key == _T0::type::first_type::str()) {
-                return true;
+            static const char * const keys[] = { T0::str(), Ti::str()... };
+
+            size_t i = 0;
+            for(; i < sizeof...(Ti) + 1; ++i)
+            {
+                if (key == keys[i])
+                    break;
             }
-            return has_key_(key, that.m_parser);
-        }
-        static bool has_key_(const std::string &, key_value_pack<> &) 
-        {
-            return false;
+            return i;
         }
 
     public:
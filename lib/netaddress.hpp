@@ -6,6 +6,8 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <cstdint>
 #include <stdexcept>
 #include <functional>
 #include <cassert>
@@ -168,6 +170,82 @@ namespace net {
         return out << ip << '/' << other.prefix();
     }
 
+    // dotted-quad/prefix without inet_ntop and temporary strings: the
+    // octets come from a table of their decimal digits...
+    //
+
+    namespace detail {
+
+        struct octet_table
+        {
+            char str[256][4];               // up to 3 digits, the length in [3]
+
+            octet_table()
+            {
+                for(int i = 0; i < 256; ++i)
+                {
+                    int n = 0;
+                    if (i >= 100)
+                        str[i][n++] = static_cast<char>('0' + i / 100);
+                    if (i >= 10)
+                        str[i][n++] = static_cast<char>('0' + i / 10 % 10);
+                    str[i][n++] = static_cast<char>('0' + i % 10);
+
+                    for(int j = n; j < 3; ++j)
+                        str[i][j] = '\0';
+                    str[i][3] = static_cast<char>(n);
+                }
+            }
+        };
+
+        inline const octet_table &
+        octets()
+        {
+            static const octet_table t;
+            return t;
+        }
+
+    } // namespace detail
+
+    // "255.255.255.255/32" is 18 chars; format copies whole table entries,
+    // the buffer needs 2 more...
+    //
+
+    static const size_t format_buffer_size = 20;
+
+    // write addr into buf (at least format_buffer_size chars, not NUL
+    // terminated), return the end of the text
+    //
+
+    inline char *
+    format(const address &addr, char *buf)
+    {
+        auto & t = detail::octets().str;
+        auto a = reinterpret_cast<const unsigned char *>(&addr.addr().s_addr);
+
+        for(int i = 0; i < 4; ++i)
+        {
+            memcpy(buf, t[a[i]], 3);
+            buf += t[a[i]][3];
+            *buf++ = i < 3 ? '.' : '/';
+        }
+
+        auto p = addr.prefix();
+
+        memcpy(buf, t[p], 3);
+        return buf + t[p][3];
+    }
+
+    // append addr to out (more::format finds it by ADL)...
+    //
+
+    inline void
+    append_to(std::string &out, const address &addr)
+    {
+        char buf[format_buffer_size];
+        out.append(buf, format(addr, buf));
+    }
+
     inline std::string
     show(const address &addr, const char * n = nullptr)
     {
@@ -175,10 +253,9 @@ namespace net {
         if (n) {
             s += std::string(n) + ' ';
         }
-        char buf[16] = { '\0' };
-        inet_ntop(AF_INET, &addr, buf, sizeof(buf));
 
-        return s + std::string(buf) + '/' + std::to_string(addr.prefix());
+        append_to(s, addr);
+        return s;
     }
 
     template <typename CharT, typename Traits>
@@ -261,6 +338,31 @@ namespace net {
     }
     
 
+    // 64-bit mixer (splitmix64 finalizer): every input bit affects every
+    // output bit, so consecutive subnets do not pile up in the low buckets
+    //
+
+    inline uint64_t
+    mix(uint64_t x)
+    {
+        x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // hash of the address and its prefix, for address_set/address_map
+    // and the unordered containers...
+    //
+
+    struct address_hash
+    {
+        size_t
+        operator()(const address &value) const
+        {
+            return static_cast<size_t>(mix((static_cast<uint64_t>(ntohl(value.addr().s_addr)) << 6) | value.prefix()));
+        }
+    };
+
 } // namespace net
 
 
@@ -283,12 +385,17 @@ namespace std {
         : min_(n)
         {}
 
+        // the address masked with the min prefix is mixed (the prefix itself
+        // is left out, as required by the min prefix); without a min
+        // prefix net::address_hash is a better choice.
+        //
+
         size_t
         operator()(const net::address& value) const
         {
             auto m = min_ == 0 ? value.prefix() : min_;
             assert( value.prefix() >= m );
-            return value.addr().s_addr & net::address::prefix2mask(m).s_addr;
+            return static_cast<size_t>(net::mix(ntohl(value.addr().s_addr & net::address::prefix2mask(m).s_addr)));
         }
 
         size_t min_;    
@@ -18,6 +18,8 @@
 #include <cctype>
 #include <stdexcept>
 #include <cassert>
+#include <type_traits>
+#include <vector>
 
 //////////////////////////////////////////////////////////////////
 // print and sprint functions: both are inspired to boost::format
@@ -178,6 +180,222 @@ namespace more {
         *sb.end() = '\0';
     }
  
+    ///////////////////////////////////////////////////////////////////////////
+    // format: the template is parsed once into a list of segments (literal
+    // text or argument index), arguments are appended to a caller-supplied
+    // string without going through an ostream (strings, chars and integers;
+    // other types can provide an append_to(std::string &, T const &) found
+    // by ADL, or are streamed).
+    //
+    // example -> static const more::format f("%1 %2");
+    //            f.append(buf, std::string("hello"), 42);
+    //
+
+    namespace detail {
+
+        template <typename T>
+        struct is_direct 
+        : std::integral_constant<bool, std::is_integral<T>::value ||
+                                       std::is_same<T, std::string>::value ||
+                                       std::is_convertible<const T &, const char *>::value>
+        {};
+
+        inline void append_to(std::string &out, std::string const &s)
+        {
+            out.append(s);
+        }
+
+        inline void append_to(std::string &out, const char *s)
+        {
+            out.append(s);
+        }
+
+        inline void append_to(std::string &out, char c)
+        {
+            out.push_back(c);
+        }
+
+        inline void append_to(std::string &out, signed char c)
+        {
+            out.push_back(static_cast<char>(c));
+        }
+
+        inline void append_to(std::string &out, unsigned char c)
+        {
+            out.push_back(static_cast<char>(c));
+        }
+
+        inline void append_to(std::string &out, bool b)
+        {
+            out.push_back(b ? '1' : '0');
+        }
+
+        template <typename T>
+        inline bool is_negative(T n, std::true_type)
+        {
+            return n < 0;
+        }
+
+        template <typename T>
+        inline bool is_negative(T, std::false_type)
+        {
+            return false;
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value, void>::type
+        append_to(std::string &out, T n)
+        {
+            typedef typename std::make_unsigned<T>::type U;
+
+            char buf[24], *p = buf + sizeof(buf);
+
+            bool neg = is_negative(n, std::is_signed<T>());
+
+            U u = neg ? static_cast<U>(0) - static_cast<U>(n) : static_cast<U>(n);
+            do {
+                *--p = static_cast<char>('0' + u % 10);
+                u /= 10;
+            }
+            while (u);
+
+            if (neg)
+                *--p = '-';
+
+            out.append(p, buf + sizeof(buf));
+        }
+
+        template <typename T>
+        typename std::enable_if<!is_direct<T>::value, void>::type
+        append_to(std::string &out, T const &arg)
+        {
+            std::ostringstream ss;
+            ss << arg;
+            out.append(ss.str());
+        }
+
+        template <typename T>
+        void append_arg(std::string &out, const void *arg)
+        {
+            append_to(out, *static_cast<const T *>(arg));
+        }
+
+    } // namespace detail
+
+    class format
+    {
+        struct segment
+        {
+            size_t pos;         // literal text: offset and length in text_
+            size_t len;
+            int    arg;         // argument index (1-based), 0 for text
+        };
+
+    public:
+        explicit format(const char *fmt)
+        {
+            enum class state { zero, percent, digit }; 
+            state s = state::zero;
+            int n = 0;
+
+            for(const char * p = fmt; *p != '\0'; ++p)
+            {
+                const char c = *p;
+                switch(s)
+                {
+                case state::zero: 
+                    {
+                        if(c != '%') {
+                            text(c); continue;
+                        }
+                        s = state::percent; continue;      
+                    }
+                case state::percent:
+                    {
+                        if(isdigit(c)) {
+                            n = (n*10)+(c-'0');
+                            s = state::digit; continue;
+                        }
+                        if(c == '%')  {
+                            text('%');
+                            s = state::zero; continue;
+                        }
+                        throw std::runtime_error("%format error%");
+                    }
+                case state::digit:
+                    {
+                        if (isdigit(c)) {
+                            n = (n*10)+(c-'0');
+                            continue;
+                        }
+                        if (c == '%') {
+                            argument(n);
+                            n = 0; s = state::percent; continue;
+                        }
+                        argument(n);
+                        text(c); 
+                        n = 0; s = state::zero; continue;
+                    }
+                }    
+            }
+            if (s == state::digit)
+                argument(n);
+
+            if (s == state::percent)
+                throw std::runtime_error("%format error%");
+        }
+
+        // append the formatted arguments to out...
+        //
+
+        template <typename ... Ts>
+        void append(std::string &out, const Ts& ... args) const
+        {
+            const void * const arg[] = { static_cast<const void *>(&args)..., nullptr };
+            void (* const fun[])(std::string &, const void *) = { &detail::append_arg<Ts>..., nullptr };
+
+            for(auto & seg : segs_)
+            {
+                if (seg.arg == 0) {
+                    out.append(text_, seg.pos, seg.len);
+                    continue;
+                }
+                if (seg.arg > static_cast<int>(sizeof...(Ts)))
+                    throw std::runtime_error("%format error%");
+
+                fun[seg.arg-1](out, arg[seg.arg-1]);
+            }
+        }
+
+        template <typename ... Ts>
+        std::string operator()(const Ts& ... args) const
+        {
+            std::string out;
+            out.reserve(text_.size() + 32 * sizeof...(Ts));
+            append(out, args...);
+            return out;
+        }
+
+    private:
+        void text(char c)
+        {
+            if (segs_.empty() || segs_.back().arg != 0)
+                segs_.push_back(segment{text_.size(), 0, 0});
+            text_.push_back(c);
+            segs_.back().len++;
+        }
+
+        void argument(int n)
+        {
+            if (n == 0)
+                throw std::runtime_error("%format error%");
+            segs_.push_back(segment{0, 0, n});
+        }
+
+        std::string text_;
+        std::vector<segment> segs_;
+    };
+ 
 } // namespace more
 
 #endif /* _MORE_PRINT_HPP_ */
@@ -381,6 +381,140 @@ inline namespace more_show {
         return show_helper::header<T>(n) + out + '}';
     }
 
+    ////////////////////////////////////////////////////////
+    // show to an ostream: the same text as show(v), written element by
+    // element (no intermediate strings for containers, tuples and pairs).
+    // With limit > 0, containers longer than 2*limit print the first and
+    // the last limit elements only, "...(+K) " in between.
+
+    namespace show_helper
+    {
+        // leaf: anything with a show() overload (found by ADL, too)
+
+        template <typename T>
+        inline void
+        stream(std::ostream &out, T const &v, size_t, long)
+        {
+            out << show(v);
+        }
+
+        template <typename U, typename V>
+        inline void
+        stream(std::ostream &out, std::pair<U,V> const &r, size_t limit, int);
+
+        template <typename T, std::size_t N>
+        inline void
+        stream(std::ostream &out, std::array<T,N> const &a, size_t limit, int);
+
+        template <typename ...Ts>
+        inline void
+        stream(std::ostream &out, std::tuple<Ts...> const &t, size_t limit, int);
+
+        template <typename T>
+        inline typename std::enable_if<
+        (!std::is_pointer<T>::value) && (
+            (more::traits::is_container<T>::value && !std::is_same<typename std::string,T>::value) ||
+            (std::rank<T>::value > 0 && !std::is_same<char, typename std::remove_cv<typename std::remove_all_extents<T>::type>::type>::value)),
+        void>::type
+        stream(std::ostream &out, T const &v, size_t limit, int);
+
+        // stream_on policy
+
+        template <typename T, int N>
+        struct stream_on
+        {
+            static inline
+            void apply(std::ostream &out, const T &tupl, size_t limit)
+            {
+                stream(out, std::get< std::tuple_size<T>::value - N>(tupl), limit, 0);
+                out << ' ';
+                stream_on<T,N-1>::apply(out, tupl, limit);
+            }
+        };
+        template <typename T>
+        struct stream_on<T, 0>
+        {
+            static inline
+            void apply(std::ostream &, const T &, size_t)
+            {}
+        };
+
+        template <typename U, typename V>
+        inline void
+        stream(std::ostream &out, std::pair<U,V> const &r, size_t limit, int)
+        {
+            out << '(';
+            stream(out, r.first, limit, 0);
+            out << ',';
+            stream(out, r.second, limit, 0);
+            out << ')';
+        }
+
+        template <typename T, std::size_t N>
+        inline void
+        stream(std::ostream &out, std::array<T,N> const &a, size_t limit, int)
+        {
+            out << '[';
+            stream_on<std::array<T,N>, N>::apply(out, a, limit);
+            out << ']';
+        }
+
+        template <typename ...Ts>
+        inline void
+        stream(std::ostream &out, std::tuple<Ts...> const &t, size_t limit, int)
+        {
+            out << "{ ";
+            stream_on<std::tuple<Ts...>, sizeof...(Ts)>::apply(out, t, limit);
+            out << '}';
+        }
+
+        template <typename T>
+        inline typename std::enable_if<
+        (!std::is_pointer<T>::value) && (
+            (more::traits::is_container<T>::value && !std::is_same<typename std::string,T>::value) ||
+            (std::rank<T>::value > 0 && !std::is_same<char, typename std::remove_cv<typename std::remove_all_extents<T>::type>::type>::value)),
+        void>::type
+        stream(std::ostream &out, T const &v, size_t limit, int)
+        {
+            auto it = std::begin(v), end = std::end(v);
+
+            out << "{ ";
+
+            if (limit != 0)
+            {
+                size_t size = static_cast<size_t>(std::distance(it, end));
+                if (size > 2 * limit)
+                {
+                    for(size_t i = 0; i < limit; ++i, ++it)
+                    {
+                        stream(out, *it, limit, 0);
+                        out << ' ';
+                    }
+
+                    out << "...(+" << (size - 2 * limit) << ") ";
+                    std::advance(it, size - 2 * limit);
+                }
+            }
+
+            for(; it != end; ++it)
+            {
+                stream(out, *it, limit, 0);
+                out << ' ';
+            }
+
+            out << '}';
+        }
+
+    } // namespace show_helper
+
+    template <typename T>
+    inline std::ostream &
+    show(std::ostream &out, T const &v, size_t limit = 0)
+    {
+        show_helper::stream(out, v, limit, 0);
+        return out;
+    }
+
 } // namespace more_show
 
 
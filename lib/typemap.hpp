@@ -18,22 +18,38 @@ namespace more { namespace type {
 
     template <typename ...Ti> struct typemap;  // a typelist of std::pair<key,value>
 
+    namespace details {
+
+        // the pairs of a typemap as base classes: the value of a key is
+        // deduced from the derived-to-base conversion, in constant
+        // instantiation depth...
+        //
+        template <typename K, typename V> struct entry {};
+        template <typename ...Ti> struct entries : entry<typename Ti::first_type, typename Ti::second_type>... {};
+
+        template <typename V> struct identity { typedef V type; };
+
+        template <typename K, typename V>
+        identity<V> lookup(entry<K,V> const *);
+
+        template <typename T> struct void_ { typedef void type; };
+
+        // index of the first true in a constant array, -1 if none
+
+        constexpr int find(bool const *b, int n, int i = 0)
+        {
+            return i == n ? -1 : b[i] ? i : find(b, n, i + 1);
+        }
+    }
+
     // get<key, typemap>::type
     //
-    template <typename Tm, typename K, typename E = void> struct get; 
-    template <typename K, typename K0, typename V0, typename ...Ki, typename ...Vi>
-    struct get<typemap<std::pair<K0, V0>, std::pair<Ki,Vi>...>, K, typename std::enable_if<!std::is_same<K,K0>::value>::type>
-    {
-        typedef typename get<typemap<std::pair<Ki,Vi>...>, K,void>::type type;
-    };
-    template <typename K, typename K0, typename V0, typename ...Ki, typename ...Vi>
-    struct get<typemap<std::pair<K0, V0>, std::pair<Ki,Vi>...>, K, typename std::enable_if<std::is_same<K,K0>::value>::type>
-    {
-        typedef V0 type;
-    };
-    template <typename K>
-    struct get<K, typemap<>>
+    template <typename Tm, typename K, typename E = void> struct get {}; 
+    template <typename K, typename ...Ki, typename ...Vi>
+    struct get<typemap<std::pair<Ki,Vi>...>, K, 
+               typename details::void_<decltype(details::lookup<K>(static_cast<details::entries<std::pair<Ki,Vi>...> *>(nullptr)))>::type>
     {
+        typedef typename decltype(details::lookup<K>(static_cast<details::entries<std::pair<Ki,Vi>...> *>(nullptr)))::type type;
     };
 
     // size<Typemap>::value
@@ -65,25 +81,17 @@ namespace more { namespace type {
 
      // index_of<Typemap, Key>::value
      //
-     template <typename Tm, typename Key, typename E = void> struct index_of;
-
-     template <typename K, typename K0, typename V0, typename ...Ki, typename ...Vi>
-     struct index_of<typemap< std::pair<K0,V0>, std::pair<Ki,Vi>...>, K, typename std::enable_if<!std::is_same<K0,K>::value>::type>
-     {
-         enum { value = index_of<typemap< std::pair<Ki,Vi>...>, K>::value == -1 ? -1 : 1 + index_of< typemap<std::pair<Ki,Vi>...>, K>::value };
-     };
+     template <typename Tm, typename Key> struct index_of;
 
-     template <typename K, typename K0, typename V0, typename ...Ki, typename ...Vi>
-     struct index_of<typemap< std::pair<K0,V0>, std::pair<Ki,Vi>...>, K, typename std::enable_if<std::is_same<K0,K>::value>::type>
+     template <typename K, typename ...Ki, typename ...Vi>
+     struct index_of<typemap< std::pair<Ki,Vi>...>, K>
      {
-         enum { value = 0 };
+         static constexpr bool same[] = { std::is_same<Ki,K>::value..., false };
+         enum { value = details::find(same, sizeof...(Ki)) };
      };
 
-     template <typename K>
-     struct index_of<typemap<>, K>
-     {
-         enum { value = -1 };
-     };
+     template <typename K, typename ...Ki, typename ...Vi>
+     constexpr bool index_of<typemap< std::pair<Ki,Vi>...>, K>::same[];
 
 }   // namespace type
 }   // namespace more
@@ -0,0 +1,281 @@
+#include <monitor.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <print.hpp>
+
+namespace topo
+{
+    namespace monitor {
+
+    namespace
+    {
+        struct state
+        {
+            off_t offset;
+            std::string tail;                   // last pattern.size()-1 bytes read
+            bool ready;
+            clock_type::time_point launch;
+            clock_type::time_point ready_at;
+        };
+
+        std::pair<std::string, std::string>
+        split_path(std::string const &path)
+        {
+            auto p = path.rfind('/');
+            if (p == std::string::npos)
+                return std::make_pair(std::string("."), path);
+            return std::make_pair(p == 0 ? std::string("/") : path.substr(0, p), path.substr(p + 1));
+        }
+
+        clock_type::time_point
+        to_time_point(struct timespec const &ts)
+        {
+            return clock_type::time_point(std::chrono::duration_cast<clock_type::duration>(
+                        std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+        }
+
+        // the log is created by the shell redirection when the VM is
+        // launched: use its birth time, if the filesystem provides it...
+        //
+
+        clock_type::time_point
+        birth_time(int fd)
+        {
+            struct statx stx;
+            if (statx(fd, "", AT_EMPTY_PATH, STATX_BTIME, &stx) == 0 && (stx.stx_mask & STATX_BTIME))
+            {
+                struct timespec ts = { static_cast<time_t>(stx.stx_btime.tv_sec),
+                                       static_cast<long>(stx.stx_btime.tv_nsec) };
+                return to_time_point(ts);
+            }
+            return clock_type::now();
+        }
+
+        // read what has been appended to the log since the last scan and
+        // look for the pattern (possibly spanning two reads)...
+        //
+
+        void
+        scan(std::string const &path, state &s, std::string const &pattern)
+        {
+            if (s.ready)
+                return;
+
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return;
+
+            if (s.launch == clock_type::time_point())
+                s.launch = birth_time(fd);
+
+            struct stat st;
+            if (fstat(fd, &st) < 0) {
+                ::close(fd);
+                return;
+            }
+
+            if (st.st_size < s.offset)          // truncated: start over
+            {
+                s.offset = 0;
+                s.tail.clear();
+            }
+
+            char buf[65536];
+            ssize_t n;
+
+            while (!s.ready && (n = ::pread(fd, buf, sizeof(buf), s.offset)) > 0)
+            {
+                s.offset += n;
+
+                std::string data = s.tail;
+                data.append(buf, static_cast<size_t>(n));
+
+                if (data.find(pattern) != std::string::npos)
+                {
+                    // the pattern was written at the latest at the last
+                    // modification of the log...
+                    //
+
+                    s.ready = true;
+                    s.ready_at = std::min(clock_type::now(), to_time_point(st.st_mtim));
+                    if (s.ready_at < s.launch)
+                        s.ready_at = s.launch;
+                    break;
+                }
+
+                auto keep = std::min(data.size(), pattern.size() - 1);
+                s.tail = data.substr(data.size() - keep);
+            }
+
+            ::close(fd);
+        }
+    }
+
+    /////////// public functions...
+
+    std::vector<report> run(std::vector<target> const &ts, std::string const &pattern, int timeout_ms)
+    {
+        if (pattern.empty())
+            throw std::runtime_error("monitor: empty readiness pattern");
+
+        int in = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (in < 0)
+            throw std::runtime_error(std::string("monitor: inotify: ") + strerror(errno));
+
+        std::vector<state> ss(ts.size(), state{0, std::string(), false, clock_type::time_point(), clock_type::time_point()});
+
+        // one watch per directory, logs are looked up by "<wd>/<name>"...
+        //
+
+        std::map<std::string, int> dirs;
+        std::unordered_map<std::string, size_t> files;
+
+        for(size_t i = 0; i < ts.size(); ++i)
+        {
+            auto p = split_path(ts[i].path);
+
+            auto it = dirs.find(p.first);
+            if (it == std::end(dirs))
+            {
+                int wd = inotify_add_watch(in, p.first.c_str(), IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO);
+                if (wd < 0)
+                {
+                    ::close(in);
+                    throw std::runtime_error("monitor: " + p.first + ": " + strerror(errno));
+                }
+                it = dirs.insert(std::make_pair(p.first, wd)).first;
+            }
+
+            files[std::to_string(it->second) + '/' + p.second] = i;
+            ss[i].launch = ts[i].launch;
+        }
+
+        // logs written before the watches were set...
+        //
+
+        size_t ready = 0;
+
+        for(size_t i = 0; i < ts.size(); ++i)
+        {
+            scan(ts[i].path, ss[i], pattern);
+            ready += ss[i].ready;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+        alignas(struct inotify_event) char buf[65536];
+
+        while (ready < ts.size())
+        {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0)
+                break;
+
+            struct pollfd pfd = { in, POLLIN, 0 };
+
+            int r = ::poll(&pfd, 1, static_cast<int>(std::min<long long>(left, 1000)));
+            if (r < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                ::close(in);
+                throw std::runtime_error(std::string("monitor: poll: ") + strerror(errno));
+            }
+
+            if (r == 0)
+                continue;
+
+            ssize_t len;
+            while ((len = ::read(in, buf, sizeof(buf))) > 0)
+            {
+                for(char *p = buf; p < buf + len; )
+                {
+                    auto ev = reinterpret_cast<struct inotify_event *>(p);
+                    p += sizeof(struct inotify_event) + ev->len;
+
+                    if (ev->mask & IN_Q_OVERFLOW)       // events lost: rescan all
+                    {
+                        for(size_t i = 0; i < ts.size(); ++i)
+                            if (!ss[i].ready)
+                                scan(ts[i].path, ss[i], pattern), ready += ss[i].ready;
+                        continue;
+                    }
+
+                    if (ev->len == 0)
+                        continue;
+
+                    auto it = files.find(std::to_string(ev->wd) + '/' + ev->name);
+                    if (it == std::end(files) || ss[it->second].ready)
+                        continue;
+
+                    scan(ts[it->second].path, ss[it->second], pattern);
+                    ready += ss[it->second].ready;
+                }
+            }
+        }
+
+        ::close(in);
+
+        std::vector<report> ret;
+        ret.reserve(ts.size());
+
+        for(size_t i = 0; i < ts.size(); ++i)
+        {
+            ret.push_back(report{ts[i].name, ss[i].ready,
+                                 ss[i].ready ? std::chrono::duration_cast<std::chrono::milliseconds>(ss[i].ready_at - ss[i].launch)
+                                             : std::chrono::milliseconds(0)});
+        }
+
+        return ret;
+    }
+
+
+    size_t show(std::ostream &out, std::vector<report> const &rs)
+    {
+        std::vector<long> lat;
+
+        for(auto & r : rs)
+        {
+            if (r.ready)
+            {
+                lat.push_back(r.latency.count());
+                more::print(out, "monitor: %1 ready %2 ms\n", r.name, r.latency.count());
+            }
+            else
+                more::print(out, "monitor: %1 not ready\n", r.name);
+        }
+
+        std::sort(lat.begin(), lat.end());
+
+        // nearest-rank percentiles...
+        //
+
+        auto pct = [&](int p) -> long
+        {
+            if (lat.empty())
+                return 0;
+            auto rank = (static_cast<size_t>(p) * lat.size() + 99) / 100;
+            return lat[std::max<size_t>(rank, 1) - 1];
+        };
+
+        more::print(out, "monitor: %1/%2 ready, p50 %3 ms p90 %4 ms p99 %5 ms max %6 ms\n",
+                    lat.size(), rs.size(), pct(50), pct(90), pct(99), lat.empty() ? 0 : lat.back());
+
+        return rs.size() - lat.size();
+    }
+
+    } // namespace monitor
+}
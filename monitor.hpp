@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace topo
+{
+    namespace monitor
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // boot-readiness monitor: follow the console logs of the VMs and
+        // wait for each of them to print the readiness pattern.
+        //
+
+        typedef std::chrono::system_clock clock_type;
+
+        struct target
+        {
+            std::string name;
+            std::string path;                   // console log
+            clock_type::time_point launch;      // spawn time (epoch: creation time of the log)
+        };
+
+        struct report
+        {
+            std::string name;
+            bool ready;
+            std::chrono::milliseconds latency;  // launch to ready
+        };
+
+        // follow all the logs at once (a single thread, inotify on their
+        // directories) until every VM is ready or timeout_ms expires...
+        //
+
+        std::vector<report> run(std::vector<target> const &ts, std::string const &pattern, int timeout_ms);
+
+        // print one line per VM and the percentiles of the ready ones,
+        // return the number of VMs not ready...
+        //
+
+        size_t show(std::ostream &out, std::vector<report> const &rs);
+
+    } // namespace monitor
+
+} // namespace topo
@@ -0,0 +1,634 @@
+#include <netlink.hpp>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <linux/if_tun.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+#include <print.hpp>
+
+namespace topo
+{
+    namespace netlink {
+
+    namespace
+    {
+        typedef std::chrono::steady_clock clock_type;
+
+        std::string
+        error(const char *what, int err)
+        {
+            return std::string("netlink: ") + what + ": " + strerror(err);
+        }
+
+        //
+        // a netlink message: header, fixed part and attributes, all of them
+        // aligned to 4 bytes...
+        //
+
+        class message
+        {
+        public:
+            message(uint16_t type, uint16_t flags)
+            : buf_(NLMSG_HDRLEN, 0)
+            {
+                hdr()->nlmsg_type  = type;
+                hdr()->nlmsg_flags = flags;
+                hdr()->nlmsg_len   = NLMSG_HDRLEN;
+            }
+
+            template <typename T>
+            void put(T const &data)
+            {
+                append(&data, sizeof(T));
+            }
+
+            void attr(uint16_t type, const void *data, size_t len)
+            {
+                struct rtattr rta;
+                rta.rta_type = type;
+                rta.rta_len  = static_cast<unsigned short>(RTA_LENGTH(len));
+                append(&rta, sizeof(rta));
+                append(data, len);
+            }
+
+            void attr(uint16_t type, std::string const &s)
+            {
+                attr(type, s.c_str(), s.size() + 1);
+            }
+
+            void attr(uint16_t type, uint32_t value)
+            {
+                attr(type, &value, sizeof(value));
+            }
+
+            size_t nest_begin(uint16_t type)
+            {
+                auto off = buf_.size();
+                attr(type, nullptr, 0);
+                return off;
+            }
+
+            void nest_end(size_t off)
+            {
+                reinterpret_cast<rtattr *>(&buf_[off])->rta_len = static_cast<unsigned short>(buf_.size() - off);
+            }
+
+            nlmsghdr *hdr()
+            {
+                return reinterpret_cast<nlmsghdr *>(buf_.data());
+            }
+
+            size_t size() const
+            {
+                return buf_.size();
+            }
+
+        private:
+            void append(const void *data, size_t len)
+            {
+                auto p = static_cast<const char *>(data);
+                if (len)
+                    buf_.insert(buf_.end(), p, p + len);
+                buf_.resize(NLMSG_ALIGN(buf_.size()), 0);
+                hdr()->nlmsg_len = static_cast<uint32_t>(buf_.size());
+            }
+
+            std::vector<char> buf_;
+        };
+
+        //
+        // rtnetlink socket: requests are queued and sent 'batch' at a time
+        // with a single sendmsg; ACKs are collected as they arrive.
+        //
+
+        class rtnl
+        {
+        public:
+            rtnl(size_t batch)
+            : fd_(::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE))
+            , batch_(std::max<size_t>(batch, 1))
+            , seq_(0)
+            , requests_(0)
+            , batches_(0)
+            {
+                if (fd_ < 0)
+                    throw std::runtime_error(error("socket", errno));
+
+                int size = 1 << 20;
+                ::setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+                ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+                sockaddr_nl sa;
+                memset(&sa, 0, sizeof(sa));
+                sa.nl_family = AF_NETLINK;
+
+                if (::bind(fd_, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0)
+                {
+                    auto err = errno; ::close(fd_);
+                    throw std::runtime_error(error("bind", err));
+                }
+            }
+
+            ~rtnl()
+            {
+                ::close(fd_);
+            }
+
+            rtnl(rtnl const &) = delete;
+            rtnl& operator=(rtnl const &) = delete;
+
+            // dump the existing links: name -> ifindex
+            //
+
+            std::map<std::string, int> links()
+            {
+                message m(RTM_GETLINK, NLM_F_REQUEST | NLM_F_DUMP);
+                ifinfomsg ifi;
+                memset(&ifi, 0, sizeof(ifi));
+                ifi.ifi_family = AF_UNSPEC;
+                m.put(ifi);
+                m.hdr()->nlmsg_seq = ++seq_;
+
+                if (::send(fd_, m.hdr(), m.size(), 0) < 0)
+                    throw std::runtime_error(error("send", errno));
+
+                std::map<std::string, int> ret;
+
+                for(bool done = false; !done; )
+                {
+                    auto len = recv_();
+
+                    for(auto h = reinterpret_cast<nlmsghdr *>(buf_.data()); NLMSG_OK(h, len); h = NLMSG_NEXT(h, len))
+                    {
+                        if (h->nlmsg_type == NLMSG_DONE) {
+                            done = true; break;
+                        }
+                        if (h->nlmsg_type == NLMSG_ERROR)
+                            throw std::runtime_error(error("dump", -reinterpret_cast<nlmsgerr *>(NLMSG_DATA(h))->error));
+                        if (h->nlmsg_type != RTM_NEWLINK)
+                            continue;
+
+                        auto ifi = reinterpret_cast<ifinfomsg *>(NLMSG_DATA(h));
+                        int alen = static_cast<int>(IFLA_PAYLOAD(h));
+
+                        for(auto a = IFLA_RTA(ifi); RTA_OK(a, alen); a = RTA_NEXT(a, alen))
+                        {
+                            if (a->rta_type == IFLA_IFNAME)
+                                ret[static_cast<const char *>(RTA_DATA(a))] = ifi->ifi_index;
+                        }
+                    }
+                }
+
+                return ret;
+            }
+
+            // queue a request (the ACK is always requested)...
+            //
+
+            void push(message m, std::string what)
+            {
+                m.hdr()->nlmsg_flags |= NLM_F_ACK;
+                m.hdr()->nlmsg_seq = ++seq_;
+
+                pending_[seq_] = std::move(what);
+                queue_.push_back(std::move(m));
+
+                if (queue_.size() >= batch_)
+                    flush();
+            }
+
+            // send the queued requests with a single sendmsg, then collect
+            // the ACKs already available...
+            //
+
+            void flush()
+            {
+                if (queue_.empty())
+                    return;
+
+                std::vector<iovec> iov(queue_.size());
+                for(size_t i = 0; i < queue_.size(); ++i)
+                {
+                    iov[i].iov_base = queue_[i].hdr();
+                    iov[i].iov_len  = queue_[i].size();
+                }
+
+                sockaddr_nl sa;
+                memset(&sa, 0, sizeof(sa));
+                sa.nl_family = AF_NETLINK;
+
+                msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_name    = &sa;
+                msg.msg_namelen = sizeof(sa);
+                msg.msg_iov     = iov.data();
+                msg.msg_iovlen  = iov.size();
+
+                while (::sendmsg(fd_, &msg, 0) < 0)
+                {
+                    if (errno != EINTR)
+                        throw std::runtime_error(error("sendmsg", errno));
+                }
+
+                requests_ += queue_.size();
+                batches_++;
+                queue_.clear();
+
+                collect_(false);
+            }
+
+            // flush and wait for all the outstanding ACKs...
+            //
+
+            void wait()
+            {
+                flush();
+                while (!pending_.empty())
+                    collect_(true);
+            }
+
+            std::vector<std::string> const &
+            errors() const
+            {
+                return errors_;
+            }
+
+            size_t requests() const { return requests_; }
+            size_t batches()  const { return batches_; }
+
+        private:
+
+            ssize_t recv_(int flags = 0)
+            {
+                if (buf_.empty())
+                    buf_.resize(1 << 16);
+
+                for(;;)
+                {
+                    auto len = ::recv(fd_, buf_.data(), buf_.size(), flags);
+                    if (len < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        if (errno == EAGAIN || errno == EWOULDBLOCK)
+                            return 0;
+                        throw std::runtime_error(error("recv", errno));
+                    }
+                    return len;
+                }
+            }
+
+            void collect_(bool block)
+            {
+                for(;;)
+                {
+                    auto len = recv_(block ? 0 : MSG_DONTWAIT);
+                    if (len == 0)
+                        return;
+
+                    for(auto h = reinterpret_cast<nlmsghdr *>(buf_.data()); NLMSG_OK(h, len); h = NLMSG_NEXT(h, len))
+                    {
+                        if (h->nlmsg_type != NLMSG_ERROR)
+                            continue;
+
+                        auto it = pending_.find(h->nlmsg_seq);
+                        if (it == std::end(pending_))
+                            continue;
+
+                        auto err = -reinterpret_cast<nlmsgerr *>(NLMSG_DATA(h))->error;
+                        if (err)
+                            errors_.push_back(error(it->second.c_str(), err));
+
+                        pending_.erase(it);
+                    }
+
+                    if (block || pending_.empty())
+                        return;
+                }
+            }
+
+            int fd_;
+            size_t batch_;
+            uint32_t seq_;
+            size_t requests_;
+            size_t batches_;
+
+            std::vector<message> queue_;
+            std::map<uint32_t, std::string> pending_;
+            std::vector<std::string> errors_;
+            std::vector<char> buf_;
+        };
+
+        //
+        // requests...
+        //
+
+        message
+        new_bridge(std::string const &name)
+        {
+            message m(RTM_NEWLINK, NLM_F_REQUEST | NLM_F_CREATE | NLM_F_EXCL);
+
+            ifinfomsg ifi;
+            memset(&ifi, 0, sizeof(ifi));
+            ifi.ifi_family = AF_UNSPEC;
+            m.put(ifi);
+
+            m.attr(IFLA_IFNAME, name);
+
+            auto info = m.nest_begin(IFLA_LINKINFO);
+            m.attr(IFLA_INFO_KIND, std::string("bridge"));
+            m.nest_end(info);
+
+            return m;
+        }
+
+        message
+        set_link(std::string const &name, int ifindex, int master)
+        {
+            message m(RTM_NEWLINK, NLM_F_REQUEST);
+
+            ifinfomsg ifi;
+            memset(&ifi, 0, sizeof(ifi));
+            ifi.ifi_family = AF_UNSPEC;
+            ifi.ifi_index  = ifindex;
+            ifi.ifi_flags  = IFF_UP;
+            ifi.ifi_change = IFF_UP;
+            m.put(ifi);
+
+            if (ifindex == 0)
+                m.attr(IFLA_IFNAME, name);
+
+            if (master > 0)
+                m.attr(IFLA_MASTER, static_cast<uint32_t>(master));
+
+            return m;
+        }
+
+        message
+        del_link(int ifindex)
+        {
+            message m(RTM_DELLINK, NLM_F_REQUEST);
+
+            ifinfomsg ifi;
+            memset(&ifi, 0, sizeof(ifi));
+            ifi.ifi_family = AF_UNSPEC;
+            ifi.ifi_index  = ifindex;
+            m.put(ifi);
+
+            return m;
+        }
+
+        // persistent tap: tun devices cannot be created through rtnetlink,
+        // the ioctl is used instead (no fork involved)...
+        //
+
+        void
+        make_tap(std::string const &name, bool multiqueue)
+        {
+            int fd = ::open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+            if (fd < 0)
+                throw std::runtime_error(error("/dev/net/tun", errno));
+
+            ifreq ifr;
+            memset(&ifr, 0, sizeof(ifr));
+            ifr.ifr_flags = IFF_TAP | IFF_NO_PI | (multiqueue ? IFF_MULTI_QUEUE : 0);
+            strncpy(ifr.ifr_name, name.c_str(), IFNAMSIZ - 1);
+
+            if (::ioctl(fd, TUNSETIFF, &ifr) < 0 ||
+                ::ioctl(fd, TUNSETPERSIST, 1) < 0)
+            {
+                auto err = errno; ::close(fd);
+                throw std::runtime_error(error(name.c_str(), err));
+            }
+
+            ::close(fd);
+        }
+
+        struct bridge
+        {
+            std::string name;
+            int base;
+            int n_if;
+            int ifindex;
+        };
+    }
+
+    /////////// public functions...
+
+    std::vector<bool> make_bridges(SwitchMap const &sm, std::set<int> const &mq, size_t batch)
+    {
+        auto start = clock_type::now();
+
+        std::vector<bool> ret;
+        ret.reserve(sm.size());
+
+        std::vector<bridge> bs;
+
+        int base = 1;
+        for(auto & s : sm)
+        {
+            auto nlink = get_num_links(s.second);
+            bool native = node_type(get_switch(s.second)) == switch_type::bridge;
+
+            if (native)
+                bs.push_back(bridge{s.first, base, nlink, 0});
+
+            ret.push_back(native);
+            base += nlink;
+        }
+
+        rtnl nl(batch);
+
+        // dump the existing links once, and look for collisions...
+        //
+
+        auto links = nl.links();
+
+        std::string clash;
+
+        auto check = [&](std::string const &name)
+        {
+            if (name.size() >= IFNAMSIZ)
+                throw std::runtime_error("netlink: " + name + ": name too long");
+            if (links.count(name))
+                clash += ' ' + name;
+        };
+
+        for(auto & b : bs)
+        {
+            check(b.name);
+            for(int t = b.base; t < b.base + b.n_if; ++t)
+                check("tap" + std::to_string(t));
+        }
+
+        if (!clash.empty())
+            throw std::runtime_error("netlink: devices already exist:" + clash);
+
+        // create bridges: the kernel chooses their ifindexes (an explicit one
+        // could be taken meanwhile by another process), read back with a
+        // second dump to enslave the taps...
+        //
+
+        for(auto & b : bs)
+            nl.push(new_bridge(b.name), "create " + b.name);
+
+        nl.wait();
+
+        if (!nl.errors().empty())
+        {
+            for(auto & e : nl.errors())
+                std::cerr << e << std::endl;
+            throw std::runtime_error("netlink: bridge creation failed");
+        }
+
+        if (!bs.empty())
+        {
+            links = nl.links();
+
+            for(auto & b : bs)
+            {
+                auto it = links.find(b.name);
+                if (it == std::end(links))
+                    throw std::runtime_error("netlink: " + b.name + ": bridge not found after creation");
+                b.ifindex = it->second;
+            }
+        }
+
+        // create the taps, enslave them and bring everything up...
+        //
+
+        size_t ntaps = 0;
+
+        for(auto & b : bs)
+        {
+            for(int t = b.base; t < b.base + b.n_if; ++t)
+            {
+                auto tap = "tap" + std::to_string(t);
+                make_tap(tap, mq.count(t) != 0);
+                nl.push(set_link(tap, 0, b.ifindex), "enslave " + tap + " to " + b.name);
+                ntaps++;
+            }
+
+            nl.push(set_link(b.name, b.ifindex, 0), "set " + b.name + " up");
+        }
+
+        nl.wait();
+
+        if (!nl.errors().empty())
+        {
+            for(auto & e : nl.errors())
+                std::cerr << e << std::endl;
+            throw std::runtime_error("netlink: bridge setup failed");
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - start);
+
+        more::print(std::cerr, "netlink: %1 bridges, %2 taps, %3 requests in %4 batches, %5 ms\n",
+                    bs.size(), ntaps, nl.requests(), nl.batches(), elapsed.count());
+
+        return ret;
+    }
+
+
+    size_t remove_links(std::vector<std::string> const &names, size_t batch)
+    {
+        auto start = clock_type::now();
+
+        rtnl nl(batch);
+
+        auto links = nl.links();
+
+        size_t n = 0;
+
+        for(auto & name : names)
+        {
+            auto it = links.find(name);
+            if (it == std::end(links))
+                continue;
+
+            nl.push(del_link(it->second), "delete " + name);
+            n++;
+        }
+
+        nl.wait();
+
+        for(auto & e : nl.errors())
+            std::cerr << e << std::endl;
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - start);
+
+        more::print(std::cerr, "netlink: %1/%2 links deleted, %3 requests in %4 batches, %5 ms\n",
+                    n - nl.errors().size(), names.size(), nl.requests(), nl.batches(), elapsed.count());
+
+        return nl.errors().size();
+    }
+
+
+
+    std::vector<std::string> add_taps(std::vector<std::string> const &bridges, bool dry_run)
+    {
+        std::vector<std::string> ret;
+
+        if (bridges.empty())
+            return ret;
+
+        rtnl nl(64);
+
+        auto links = nl.links();
+
+        int last = 0;
+        for(auto & l : links)
+        {
+            if (l.first.compare(0, 3, "tap") == 0 && l.first.size() > 3 &&
+                l.first.find_first_not_of("0123456789", 3) == std::string::npos)
+                last = std::max(last, std::atoi(l.first.c_str() + 3));
+        }
+
+        for(auto & b : bridges)
+        {
+            auto it = links.find(b);
+            if (it == std::end(links))
+                throw std::runtime_error("netlink: " + b + ": no such bridge");
+
+            auto tap = "tap" + std::to_string(++last);
+
+            if (!dry_run)
+            {
+                make_tap(tap, false);
+                nl.push(set_link(tap, 0, it->second), "enslave " + tap + " to " + b);
+            }
+
+            ret.push_back(std::move(tap));
+        }
+
+        nl.wait();
+
+        if (!nl.errors().empty())
+        {
+            for(auto & e : nl.errors())
+                std::cerr << e << std::endl;
+            throw std::runtime_error("netlink: tap setup failed");
+        }
+
+        return ret;
+    }
+
+    } // namespace netlink
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <network.hpp>
+
+#include <string>
+#include <vector>
+#include <set>
+
+namespace topo
+{
+    namespace netlink
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // native backend for the bridge phase: bridges are created and taps
+        // enslaved/brought up through a single rtnetlink socket, with many
+        // requests per sendmsg and the ACKs collected as they arrive.
+        //
+        // Only switches of type bridge are handled; the returned vector
+        // tells, for each switch of the map (in map order), whether it
+        // has been set up natively.
+        //
+        // Links are dumped once up front: a collision with an existing
+        // device aborts the setup before anything is created.
+        //
+        // Taps listed in mq are created multiqueue.
+        //
+
+        std::vector<bool> make_bridges(SwitchMap const &sm, std::set<int> const &mq, size_t batch = 64);
+
+        // delete the links (RTM_DELLINK, 'batch' requests per sendmsg);
+        // the ones that do not exist are skipped. Returns the number of
+        // failed requests.
+        //
+
+        size_t remove_links(std::vector<std::string> const &names, size_t batch = 64);
+
+        // hot-plug: one persistent tap per bridge of the list, enslaved and
+        // brought up as by make_bridges, named past the highest tapN on the
+        // host (not to collide with the taps of the running topology).
+        // Returns the names; with dry_run nothing is created.
+        //
+
+        std::vector<std::string> add_taps(std::vector<std::string> const &bridges, bool dry_run = false);
+
+    } // namespace netlink
+
+} // namespace topo
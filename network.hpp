@@ -4,6 +4,12 @@
 #include <tuple>
 #include <vector>
 #include <map>
+#include <stdexcept>
+#include <cctype>
+#include <cstdlib>
+#include <initializer_list>
+#include <limits>
+#include <algorithm>
 
 #include <netaddress.hpp>
 #include <show.hpp>
@@ -57,6 +63,12 @@ namespace topo {
         return std::get<0>(n);
     }
     
+    inline bool
+    is_overlay(opt::image_type const &image)
+    {
+        return image.opt == "overlay";
+    }
+
     inline opt::image_type
     node_image(Node const &n)
     {
@@ -75,6 +87,21 @@ namespace topo {
         return std::get<3>(n);
     }
 
+    // stable id of the n-th NIC of a node: "<switch>-<k>", being k the
+    // occurrence of the switch among the previous ports of the node
+    // (used to name the qemu netdev/device, e.g. for QMP hot-plug).
+    //
+
+    inline std::string
+    nic_id(std::vector<Port> const &ports, size_t n)
+    {
+        int k = 0;
+        for(size_t i = 0; i < n; ++i)
+            k += port_linkname(ports[i]) == port_linkname(ports[n]);
+
+        return port_linkname(ports[n]) + '-' + std::to_string(k);
+    }
+
     ///////////////////////////////////////////////////////////////////////////
     //
     // Switch...
@@ -85,7 +112,9 @@ namespace topo {
         bridge,
         macvtap,
         macvtap2,
-        vale
+        vale,
+        vhostuser,
+        p2p
     };
 
     template <typename CharT, typename Traits>
@@ -102,6 +131,10 @@ namespace topo {
             return out << "macvtap2";
         case switch_type::vale:
             return out << "vale";
+        case switch_type::vhostuser:
+            return out << "vhostuser";
+        case switch_type::p2p:
+            return out << "p2p";
         }
         return out;
     }
@@ -130,6 +163,14 @@ namespace topo {
         {
             return that = switch_type::vale, in;
         }
+        if (s.compare("vhostuser") == 0)
+        {
+            return that = switch_type::vhostuser, in;
+        }
+        if (s.compare("p2p") == 0)
+        {
+            return that = switch_type::p2p, in;
+        }
 
         in.setstate(std::ios_base::failbit);         
         return in;
@@ -197,6 +238,16 @@ namespace topo {
         return std::get<3>(i);
     }
 
+    // index of the first port (tap) of the switch, before or after the
+    // taps have been assigned...
+    //
+
+    inline int
+    get_base(SwitchInfo const &i)
+    {
+        return get_index(i) - (get_num_links(i) - get_avail(i));
+    }
+
 
     typedef std::map<std::string, SwitchInfo> SwitchMap;
 
@@ -209,4 +260,332 @@ namespace topo {
     
     typedef std::vector<Node> Nodes;
 
+    ///////////////////////////////////////////////////////////////////////////
+    //
+    // Settings: per-node ("vrouter0") or per-port ("vrouter0:1") tuning,
+    // link shaping per-switch ("wan0") as well
+    //
+    // settings = [ 
+    //              vrouter0     -> [ smp 4 vhost on ]
+    //              "vrouter0:1" -> [ queues 2 offload csum,gso ]
+    //              wan0         -> [ delay 20ms jitter 5ms loss 0.1% rate 10mbit ]
+    //            ]
+    //
+
+    typedef std::map<std::string, std::vector<opt::setting_type>> Settings;
+
+    // every key must name a switch (link shaping only), a node, or a port
+    // of a node ("name:port", without the node-wide smp and mem)...
+    //
+
+    inline void
+    check_settings(Settings const &st, SwitchMap const &sm, TapMap const &tm)
+    {
+        for(auto & e : st)
+        {
+            auto & key = e.first;
+
+            bool is_node = tm.count(key) != 0, is_port = false;
+            bool is_switch = !is_node && sm.count(key) != 0;
+
+            if (!is_node && !is_switch)
+            {
+                auto colon = key.rfind(':');
+                auto it = colon == std::string::npos ? std::end(tm) : tm.find(key.substr(0, colon));
+                auto port = key.substr(colon + 1);
+
+                if (it == std::end(tm) || port.empty() || port.size() > 9 ||
+                    port.find_first_not_of("0123456789") != std::string::npos ||
+                    std::stoul(port) >= it->second.size())
+                    throw std::runtime_error("settings: " + key + ": no such switch, node or port");
+
+                is_port = true;
+            }
+
+            for(auto & s : e.second)
+            {
+                bool shaping = s.opt == "delay" || s.opt == "jitter" || s.opt == "loss" || s.opt == "rate";
+                bool node    = s.opt == "smp" || s.opt == "mem";
+
+                if ((is_switch && !shaping) || (is_port && node))
+                    throw std::runtime_error("settings: " + key + ": " + s.opt + " cannot be set on a " + (is_switch ? "switch" : "port"));
+            }
+        }
+    }
+
+    typedef std::tuple<int,                 // queues
+                       bool,                // vhost-net
+                       std::string>         // offload flags
+                       NicConf;
+
+    inline int
+    nic_queues(NicConf const &c)
+    {
+        return std::get<0>(c);
+    }
+
+    inline bool
+    nic_vhost(NicConf const &c)
+    {
+        return std::get<1>(c);
+    }
+
+    inline std::string
+    nic_offload(NicConf const &c)
+    {
+        return std::get<2>(c);
+    }
+
+    inline bool
+    nic_is_default(NicConf const &c)
+    {
+        return nic_queues(c) == 1 && !nic_vhost(c) && nic_offload(c).empty();
+    }
+
+    // most queues of a NIC (MAX_TAP_QUEUES of the kernel)...
+
+    const int max_queues = 256;
+
+    namespace detail
+    {
+        // a positive integer, all of the value, at most max...
+
+        inline int
+        setting_int(opt::setting_type const &s, std::string const &key, int max = std::numeric_limits<int>::max())
+        {
+            try
+            {
+                size_t pos;
+                auto const & v = s.args.at(0);
+                auto n = std::stoi(v, &pos);
+                if (pos == v.size() && n > 0 && n <= max)
+                    return n;
+            }
+            catch(std::exception &) 
+            {}
+
+            throw std::runtime_error("settings: " + key + ": invalid " + s.opt + " value");
+        }
+
+        // a number followed by one of the units (tc syntax, e.g. "20ms",
+        // "10mbit"); the value ends up in a shell command line, anything
+        // else is rejected...
+
+        inline std::string
+        setting_unit(opt::setting_type const &s, std::string const &key, std::initializer_list<const char *> units)
+        {
+            auto const & v = s.args.at(0);
+
+            char *end;
+            auto n = std::strtod(v.c_str(), &end);
+
+            if (end != v.c_str() && isdigit(v[0]) && n >= 0 && v.size() <= 16)
+            {
+                for(auto u : units)
+                    if (std::string(end) == u)
+                        return v;
+            }
+
+            throw std::runtime_error("settings: " + key + ": invalid " + s.opt + " value");
+        }
+
+        // comma separated virtio-net flags, each one [a-z0-9_]+ with an
+        // optional leading '-' (it ends up in a shell command line)...
+
+        inline std::string
+        setting_flags(opt::setting_type const &s, std::string const &key)
+        {
+            auto const & v = s.args.at(0);
+
+            bool ok = !v.empty() && v.size() <= 256;
+
+            for(size_t i = 0; ok && i < v.size(); )
+            {
+                auto end = v.find(',', i);
+                if (end == std::string::npos)
+                    end = v.size();
+
+                auto f = i + (v[i] == '-');
+
+                ok = f < end;
+                for(; ok && f < end; ++f)
+                    ok = islower(v[f]) || isdigit(v[f]) || v[f] == '_';
+
+                i = end + 1;
+                ok = ok && i != v.size();       // no trailing comma
+            }
+
+            if (!ok)
+                throw std::runtime_error("settings: " + key + ": invalid " + s.opt + " value");
+            return v;
+        }
+
+        inline bool
+        setting_bool(opt::setting_type const &s, std::string const &key)
+        {
+            auto const & v = s.args.at(0);
+            if (v == "on"  || v == "true"  || v == "1")
+                return true;
+            if (v == "off" || v == "false" || v == "0")
+                return false;
+
+            throw std::runtime_error("settings: " + key + ": invalid " + s.opt + " value");
+        }
+    }
+
+    // number of vCPUs of a node (default 1)
+    //
+
+    inline int
+    node_smp(Settings const &st, std::string const &node)
+    {
+        int ret = 1;
+
+        auto it = st.find(node);
+        if (it != std::end(st))
+        {
+            for(auto & s : it->second)
+                if (s.opt == "smp")
+                    ret = detail::setting_int(s, node);
+        }
+
+        return ret;
+    }
+
+    // guest memory of a node in MB (0: not set, the default of startmv.sh)
+    //
+
+    inline int
+    node_mem(Settings const &st, std::string const &node)
+    {
+        int ret = 0;
+
+        auto it = st.find(node);
+        if (it != std::end(st))
+        {
+            for(auto & s : it->second)
+                if (s.opt == "mem")
+                    ret = detail::setting_int(s, node);
+        }
+
+        return ret;
+    }
+
+    // NIC configuration of the n-th port of a node: node settings first,
+    // then overridden by the port ones. Queues default to the vCPU count
+    // of the node, at most max_queues.
+    //
+
+    inline NicConf
+    nic_conf(Settings const &st, std::string const &node, size_t port)
+    {
+        NicConf ret(std::min(node_smp(st, node), max_queues), false, std::string());
+
+        auto apply = [&](std::string const &key)
+        {
+            auto it = st.find(key);
+            if (it == std::end(st))
+                return;
+
+            for(auto & s : it->second)
+            {
+                if (s.opt == "queues")
+                    std::get<0>(ret) = detail::setting_int(s, key, max_queues);
+                else if (s.opt == "vhost")
+                    std::get<1>(ret) = detail::setting_bool(s, key);
+                else if (s.opt == "offload")
+                    std::get<2>(ret) = detail::setting_flags(s, key);
+            }
+        };
+
+        apply(node);
+        apply(node + ':' + std::to_string(port));
+
+        return ret;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    //
+    // LinkConf: shaping of the traffic sent to a port (netem on its tap)
+    //
+
+    typedef std::tuple<std::string,         // delay  (e.g. 20ms)
+                       std::string,         // jitter (e.g. 5ms)
+                       std::string,         // loss   (e.g. 0.1%)
+                       std::string>         // rate   (e.g. 10mbit)
+                       LinkConf;
+
+    inline std::string
+    link_delay(LinkConf const &c)
+    {
+        return std::get<0>(c);
+    }
+
+    inline std::string
+    link_jitter(LinkConf const &c)
+    {
+        return std::get<1>(c);
+    }
+
+    inline std::string
+    link_loss(LinkConf const &c)
+    {
+        return std::get<2>(c);
+    }
+
+    inline std::string
+    link_rate(LinkConf const &c)
+    {
+        return std::get<3>(c);
+    }
+
+    inline bool
+    link_is_default(LinkConf const &c)
+    {
+        return link_delay(c).empty() && link_jitter(c).empty() && link_loss(c).empty() && link_rate(c).empty();
+    }
+
+    // link shaping of the n-th port of a node: the settings of its switch
+    // first, then overridden by the node and the port ones...
+    //
+
+    inline LinkConf
+    link_conf(Settings const &st, std::string const &sw, std::string const &node, size_t port)
+    {
+        LinkConf ret;
+
+        auto apply = [&](std::string const &key)
+        {
+            auto it = st.find(key);
+            if (it == std::end(st))
+                return;
+
+            for(auto & s : it->second)
+            {
+                if (s.opt == "delay")
+                    std::get<0>(ret) = detail::setting_unit(s, key, { "us", "ms", "s" });
+                else if (s.opt == "jitter")
+                    std::get<1>(ret) = detail::setting_unit(s, key, { "us", "ms", "s" });
+                else if (s.opt == "loss")
+                {
+                    auto v = detail::setting_unit(s, key, { "", "%" });
+                    if (std::strtod(v.c_str(), nullptr) > 100)
+                        throw std::runtime_error("settings: " + key + ": invalid loss value");
+                    std::get<2>(ret) = v.back() == '%' ? v : v + '%';
+                }
+                else if (s.opt == "rate")
+                    std::get<3>(ret) = detail::setting_unit(s, key, { "bit", "kbit", "mbit", "gbit", "bps", "kbps", "mbps", "gbps" });
+            }
+        };
+
+        apply(sw);
+        apply(node);
+        apply(node + ':' + std::to_string(port));
+
+        if (!link_jitter(ret).empty() && link_delay(ret).empty())
+            throw std::runtime_error("settings: " + node + ':' + std::to_string(port) + ": jitter without delay");
+
+        return ret;
+    }
+
 } // namespace topo
@@ -6,12 +6,15 @@ namespace opt {
 
     // option<image>:
     //
-    // image opt1.img or
-    // qcow  opt1.img
+    // image   opt1.img or
+    // qcow    opt1.img or
+    // overlay base.img   (qcow2 overlay on top of a shared base, qcow2 or raw:
+    //                     its format is detected)
     //
     
-    OPTION_KIND(image, { "image", { "-o", 1 } },
-                       { "qcow" , { "-q", 1 } }
+    OPTION_KIND(image, { "image",   { "-o", 1 } },
+                       { "qcow" ,   { "-q", 1 } },
+                       { "overlay", { "overlay", 1 } }
            )
 
 
@@ -19,5 +22,22 @@ namespace opt {
                       { "vnc" ,   { "-v", 1 } }
            )
 
+    // option<setting>: per-node/per-port tuning
+    //
+    // smp 4 mem 1024 queues 4 vhost on offload csum,gso,-guest_ufo
+    // delay 20ms jitter 5ms loss 0.1% rate 10mbit
+    //
+
+    OPTION_KIND(setting, { "smp",     { "smp",     1 } },
+                         { "mem",     { "mem",     1 } },
+                         { "queues",  { "queues",  1 } },
+                         { "vhost",   { "vhost",   1 } },
+                         { "offload", { "offload", 1 } },
+                         { "delay",   { "delay",   1 } },
+                         { "jitter",  { "jitter",  1 } },
+                         { "loss",    { "loss",    1 } },
+                         { "rate",    { "rate",    1 } }
+           )
+
 
 } // namespace opt
@@ -1,12 +1,18 @@
 #include <key_value.hpp>
 
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
 #include <vector>
 #include <string>
+#include <stdexcept>
 
 #include <network.hpp>
 
 namespace topo {
-                                       
+
     enum class parser_type
     {
         basic
@@ -15,18 +21,383 @@ namespace topo {
     namespace basic {
     namespace parser {
 
+        namespace details
+        {
+            // largest index of a node template (and operand of a placeholder)...
+
+            const long max_index = 1000000;
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // pattern: a field of a node template, with placeholders of the
+        // index: {i}, or {i} followed by operators applied left to right
+        // (+n -n *n /n %n), e.g. "10.{i/256}.{i%256}.1/16". The text is
+        // split once, then instantiated for every index of the range.
+        //
+
+        class pattern
+        {
+        public:
+            pattern()
+            : pieces_()
+            {}
+
+            explicit pattern(std::string const &text)
+            : pieces_()
+            {
+                size_t pos = 0;
+
+                while (pos < text.size())
+                {
+                    auto open = text.find('{', pos);
+
+                    if (open != pos)
+                        pieces_.push_back(piece{text.substr(pos, open - pos), {}, false});
+
+                    if (open == std::string::npos)
+                        break;
+
+                    auto close = text.find('}', open);
+                    if (close == std::string::npos || close == open + 1 || text[open + 1] != 'i')
+                        throw std::runtime_error("parser: " + text + ": invalid placeholder");
+
+                    piece p{std::string(), {}, true};
+
+                    // bound of |value| for any index, with room for one more
+                    // operand: the instantiation cannot overflow...
+
+                    long bound = details::max_index;
+
+                    for(size_t c = open + 2; c < close;)
+                    {
+                        auto code = text[c++];
+                        if (std::string("+-*/%").find(code) == std::string::npos || c == close || !isdigit(text[c]))
+                            throw std::runtime_error("parser: " + text + ": invalid placeholder");
+
+                        long arg = 0;
+                        while (c < close && isdigit(text[c]))
+                            arg = std::min(arg * 10 + (text[c++] - '0'), details::max_index + 1);
+
+                        if (arg > details::max_index)
+                            throw std::runtime_error("parser: " + text + ": operand above " + std::to_string(details::max_index));
+
+                        if (arg == 0 && (code == '/' || code == '%'))
+                            throw std::runtime_error("parser: " + text + ": division by zero");
+
+                        switch(code)
+                        {
+                        case '+':
+                        case '-': bound += arg; break;
+                        case '*': bound = arg && bound > std::numeric_limits<long>::max() / arg ? -1 : bound * arg; break;
+                        case '%': bound = std::min(bound, arg - 1); break;
+                        }
+
+                        if (bound < 0 || bound > std::numeric_limits<long>::max() - details::max_index)
+                            throw std::runtime_error("parser: " + text + ": placeholder value out of range");
+
+                        p.ops.push_back(op{code, arg});
+                    }
+
+                    pieces_.push_back(std::move(p));
+                    pos = close + 1;
+                }
+            }
+
+            bool
+            is_literal() const
+            {
+                for(auto & p : pieces_)
+                    if (p.expr)
+                        return false;
+                return true;
+            }
+
+            void
+            append(std::string &out, long i) const
+            {
+                for(auto & p : pieces_)
+                {
+                    if (!p.expr) {
+                        out += p.text;
+                        continue;
+                    }
+
+                    auto v = i;
+                    for(auto & o : p.ops)
+                    {
+                        switch(o.code)
+                        {
+                        case '+': v += o.arg; break;
+                        case '-': v -= o.arg; break;
+                        case '*': v *= o.arg; break;
+                        case '/': v /= o.arg; break;
+                        case '%': v %= o.arg; break;
+                        }
+                    }
+
+                    out += std::to_string(v);
+                }
+            }
+
+            std::string
+            operator()(long i) const
+            {
+                std::string ret;
+                append(ret, i);
+                return ret;
+            }
+
+        private:
+            struct op
+            {
+                char code;
+                long arg;
+            };
+
+            struct piece
+            {
+                std::string text;
+                std::vector<op> ops;
+                bool expr;
+            };
+
+            std::vector<piece> pieces_;
+        };
+
+        // a pattern is a token ending at a blank or at a bracket...
+        //
+
+        template <typename CharT, typename Traits>
+        typename std::basic_istream<CharT, Traits> &
+        operator>>(std::basic_istream<CharT,Traits>& in, pattern& that)
+        {
+            std::string text;
+
+            if (!(in >> std::ws))
+                return in;
+
+            for(auto c = in.peek(); c != Traits::eof() && !isspace(c) && std::string("[]()").find(static_cast<char>(c)) == std::string::npos; c = in.peek())
+                text.push_back(static_cast<char>(in.get()));
+
+            if (text.empty())
+                in.setstate(std::ios_base::failbit);
+            else
+                that = pattern(text);
+
+            return in;
+        }
+
+        namespace details
+        {
+            // "a.b.c.d/n" or "a.b.c.d/m.m.m.m" (as net::address operator>>)...
+            //
+
+            inline net::address
+            make_address(std::string const &node, std::string const &text)
+            {
+                auto s = text.size() > 1 && (text.front() == '"' || text.front() == '\'') ? text.substr(1, text.size() - 2) : text;
+                auto slash = s.find('/');
+
+                in_addr a, m;
+
+                if (slash != std::string::npos && inet_pton(AF_INET, s.substr(0, slash).c_str(), &a) > 0)
+                {
+                    auto mask = s.substr(slash + 1);
+
+                    if (inet_pton(AF_INET, mask.c_str(), &m) > 0)
+                        return net::address(a, m);
+
+                    char *end;
+                    auto n = std::strtoul(mask.c_str(), &end, 10);
+                    if (!mask.empty() && *end == '\0' && n <= 32)
+                        return net::address(a, n);
+                }
+
+                throw std::runtime_error("parser: " + node + ": invalid address " + text);
+            }
+
+            // an index saturates at max_index + 1 (no overflow)...
+            //
+
+            template <typename CharT, typename Traits>
+            bool
+            read_index(std::basic_istream<CharT,Traits>& in, long &n)
+            {
+                if (!isdigit(in.peek()))
+                    return false;
+
+                n = 0;
+                while (isdigit(in.peek()))
+                    n = std::min(n * 10 + (in.get() - '0'), max_index + 1);
+
+                return true;
+            }
+
+            // instantiate the node template for the indices first..last...
+            //
+
+            inline void
+            expand(Nodes &ns, std::string const &name, long first, long last,
+                   opt::image_type const &image,
+                   opt::term_type const &term,
+                   std::vector<std::pair<pattern, pattern>> const &ports)
+            {
+                std::vector<pattern> image_args, term_args;
+
+                for(auto & a : image.args)
+                    image_args.emplace_back(a);
+                for(auto & a : term.args)
+                    term_args.emplace_back(a);
+
+                // addresses without placeholders are parsed once...
+
+                std::vector<net::address> fixed;
+                for(auto & p : ports)
+                    fixed.push_back(p.first.is_literal() ? make_address(name, p.first(first)) : net::address());
+
+                ns.reserve(ns.size() + static_cast<size_t>(last - first + 1));
+
+                for(long i = first; i <= last; ++i)
+                {
+                    auto id = name + std::to_string(i);
+
+                    opt::image_type img{image.opt, {}};
+                    for(auto & a : image_args)
+                        img.args.push_back(a(i));
+
+                    opt::term_type tty{term.opt, {}};
+                    for(auto & a : term_args)
+                        tty.args.push_back(a(i));
+
+                    std::vector<Port> ps;
+                    ps.reserve(ports.size());
+
+                    for(size_t n = 0; n < ports.size(); ++n)
+                        ps.emplace_back(ports[n].first.is_literal() ? fixed[n] : make_address(id, ports[n].first(i)),
+                                        ports[n].second(i));
+
+                    ns.emplace_back(std::move(id), std::move(img), std::move(tty), std::move(ps));
+                }
+            }
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // list of nodes: besides the plain ones, a node template is expanded
+        // over a range of indices while parsing:
+        //
+        //  ( vrouter[0..999]  image "opt{i%4}.img"  tty {i+1}
+        //                     [ 10.{i/256}.{i%256}.1/16 -> lan{i/100} ] )
+        //
+        // gives the nodes vrouter0 ... vrouter999 (indices up to 1000000).
+        // The image, term, address and switch fields can contain index
+        // placeholders (see pattern).
+        //
+
+        struct NodeList : std::vector<Node>
+        {};
+
+    } // namespace parser
+    } // namespace basic
+
+} // namespace topo
+
+namespace more { namespace traits {
+
+    // parsed by its own operator>>, not as a container...
+    //
+
+    template <>
+    struct is_container<topo::basic::parser::NodeList> : std::false_type
+    {};
+
+} // namespace traits
+} // namespace more
+
+namespace topo {
+
+    namespace basic {
+    namespace parser {
+
+        template <typename CharT, typename Traits>
+        typename std::basic_istream<CharT, Traits> &
+        operator>>(std::basic_istream<CharT,Traits>& in, NodeList& that)
+        {
+            auto lex = more::make_lexer(in, more::parser_options(false, '=', '#', "nodes"));
+
+            if (!lex._('['))
+                return in;
+
+            while (!lex._(']'))
+            {
+                std::string name;
+                opt::image_type image;
+                opt::term_type term;
+
+                if (!in || !lex._('(') || !lex.parse_lexeme(name).first)
+                    return in.setstate(std::ios_base::failbit), in;
+
+                // plain node...
+                //
+
+                if (in.peek() != '[')
+                {
+                    std::vector<Port> ports;
+
+                    if (!lex.parse_lexeme(image).first || !lex.parse_lexeme(term).first ||
+                        !lex.parse_lexeme(ports).first || !lex._(')'))
+                        return in.setstate(std::ios_base::failbit), in;
+
+                    that.emplace_back(std::move(name), std::move(image), std::move(term), std::move(ports));
+                    continue;
+                }
+
+                // node template: name[first..last]...
+                //
+
+                long first, last;
+                in.get();
+
+                if (!details::read_index(in, first) || in.get() != '.' || in.get() != '.' ||
+                    !details::read_index(in, last)  || in.get() != ']')
+                    throw std::runtime_error("parser: " + name + ": invalid range (name[first..last])");
+
+                if (last > details::max_index)
+                    throw std::runtime_error("parser: " + name + ": index above " + std::to_string(details::max_index));
+
+                if (last < first)
+                    throw std::runtime_error("parser: " + name + ": invalid range (first > last)");
+
+                std::vector<std::pair<pattern, pattern>> ports;
+
+                if (!lex.parse_lexeme(image).first || !lex.parse_lexeme(term).first ||
+                    !lex.parse_lexeme(ports).first || !lex._(')'))
+                    return in.setstate(std::ios_base::failbit), in;
+
+                details::expand(that, name, first, last, image, term, ports);
+            }
+
+            return in;
+        }
+
         // declare a vector of nodes:
         //
-        
-        MAP_KEY(std::vector<Node>, nodes)
+
+        MAP_KEY(NodeList, nodes)
 
         // declare a vector of switching services:
         //
 
         MAP_KEY(std::vector<Switch>, switches)
-        
 
-        typedef more::key_value_pack<nodes, switches> type;
+        // declare the per-node/per-port settings:
+        //
+
+        MAP_KEY(Settings, settings)
+
+
+        typedef more::key_value_pack<nodes, switches, settings> type;
 
 
     } // namespace parser
@@ -0,0 +1,151 @@
+#include <prewarm.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <thread>
+
+#include <print.hpp>
+
+namespace topo
+{
+    namespace prewarm {
+
+    namespace
+    {
+        typedef std::chrono::steady_clock clock_type;
+
+        const size_t chunk = 8 << 20;
+
+        // bytes of the file resident in the page cache...
+        //
+
+        uint64_t
+        resident(int fd, uint64_t size)
+        {
+            if (size == 0)
+                return 0;
+
+            auto addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED)
+                return 0;
+
+            auto page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+            std::vector<unsigned char> vec((size + page - 1) / page);
+
+            uint64_t ret = 0;
+
+            if (mincore(addr, size, vec.data()) == 0)
+            {
+                for(size_t i = 0; i < vec.size(); ++i)
+                    if (vec[i] & 1)
+                        ret += std::min(page, size - i * page);
+            }
+
+            munmap(addr, size);
+            return ret;
+        }
+
+        void
+        load(file &f)
+        {
+            int fd = ::open(f.path.c_str(), O_RDONLY|O_CLOEXEC);
+            if (fd < 0)
+                return;
+
+            struct stat st;
+
+            if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+            {
+                f.found  = true;
+                f.size   = static_cast<uint64_t>(st.st_size);
+                f.cached = resident(fd, f.size);
+
+                if (f.cached < f.size)
+                {
+                    for(uint64_t off = 0; off < f.size; off += chunk)
+                        if (readahead(fd, static_cast<off64_t>(off), chunk) < 0)
+                            break;
+                }
+
+                f.resident = resident(fd, f.size);
+            }
+
+            ::close(fd);
+        }
+
+        std::string
+        megabytes(uint64_t n)
+        {
+            return std::to_string((n + (1 << 19)) >> 20) + " MB";
+        }
+    }
+
+    /////////// public functions...
+
+    report run(std::vector<std::string> const &paths, int threads)
+    {
+        report r;
+
+        std::set<std::string> seen;
+
+        for(auto & p : paths)
+            if (seen.insert(p).second)
+                r.files.push_back(file{p, false, 0, 0, 0});
+
+        auto start = clock_type::now();
+
+        std::atomic<size_t> next(0);
+
+        auto worker = [&]()
+        {
+            for(size_t i; (i = next++) < r.files.size(); )
+                load(r.files[i]);
+        };
+
+        std::vector<std::thread> pool;
+
+        for(size_t n = 1; n < std::min<size_t>(std::max(threads, 1), r.files.size()); ++n)
+            pool.emplace_back(worker);
+
+        worker();
+
+        for(auto & t : pool)
+            t.join();
+
+        r.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start);
+        return r;
+    }
+
+
+    void show(std::ostream &out, report const &r)
+    {
+        size_t found = 0;
+        uint64_t size = 0, cached = 0, res = 0;
+
+        for(auto & f : r.files)
+        {
+            if (!f.found) {
+                more::print(out, "prewarm: %1: not found\n", f.path);
+                continue;
+            }
+
+            found++;
+            size   += f.size;
+            cached += f.cached;
+            res    += f.resident;
+        }
+
+        more::print(out, "prewarm: %1 files, %2 (%3 cached), %4 resident, %5 ms\n",
+                    found, megabytes(size), megabytes(cached), megabytes(res),
+                    std::chrono::duration_cast<std::chrono::milliseconds>(r.elapsed).count());
+    }
+
+    } // namespace prewarm
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace topo
+{
+    namespace prewarm
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // boot-artifact prewarming: fault the files every VM reads at boot
+        // (kernel, initramfs, shared base images) into the page cache before
+        // the launches, with readahead(2) on a few threads, so that the VMs
+        // do not hit the disk all at once. The residency of the files is
+        // measured with mincore(2) before and after.
+        //
+
+        struct file
+        {
+            std::string path;
+            bool found;
+            uint64_t size;
+            uint64_t cached;                    // bytes resident before
+            uint64_t resident;                  // bytes resident after
+        };
+
+        struct report
+        {
+            std::vector<file> files;
+            std::chrono::microseconds elapsed;
+        };
+
+        // prewarm the files (duplicates are read once) with at most
+        // 'threads' of them in flight; missing files are reported, not
+        // an error...
+        //
+
+        report run(std::vector<std::string> const &paths, int threads);
+
+        // one line per missing file and a summary line, e.g.
+        // "prewarm: 3 files, 250 MB (12 MB cached), 250 MB resident, 840 ms"
+        //
+
+        void show(std::ostream &out, report const &r);
+
+    } // namespace prewarm
+
+} // namespace topo
@@ -0,0 +1,466 @@
+#include <qmp.hpp>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+
+#include <print.hpp>
+
+namespace topo
+{
+    namespace qmp {
+
+    namespace
+    {
+        typedef std::chrono::steady_clock clock_type;
+
+        //
+        // a QMP connection: greeting -> qmp_capabilities -> commands...
+        //
+
+        struct connection
+        {
+            enum class state { greeting, capabilities, command, deleting, done, failed };
+
+            session const *s;
+            int fd;
+            state st;
+            size_t next;
+            bool deleted;                   // DEVICE_DELETED of the current command seen
+            std::string in;
+            std::string out;
+            std::string error;
+            clock_type::time_point deadline;
+        };
+
+        // the kind of a QMP message, by the top-level key it has: "QMP",
+        // "return", "error" or "event" (an event may begin with its
+        // "timestamp"), empty if none...
+        //
+
+        std::string
+        message_kind(std::string const &msg)
+        {
+            static const char * const kinds[] = { "QMP", "return", "error", "event" };
+
+            int depth = 0;
+            bool key = false;               // the next string at depth 1 is a key
+
+            for(size_t i = 0; i < msg.size(); ++i)
+            {
+                auto c = msg[i];
+
+                if (c == '"')
+                {
+                    auto e = i + 1;
+                    while (e < msg.size() && msg[e] != '"')
+                        e += msg[e] == '\\' ? 2 : 1;
+                    if (e >= msg.size())
+                        return std::string();
+
+                    if (depth == 1 && key)
+                    {
+                        auto k = msg.substr(i + 1, e - i - 1);
+                        for(auto kind : kinds)
+                            if (k == kind)
+                                return k;
+                        key = false;
+                    }
+                    i = e;
+                }
+                else if (c == '{' || c == '[')
+                    key = ++depth == 1 && c == '{';
+                else if (c == '}' || c == ']')
+                    depth--;
+                else if (c == ',' && depth == 1)
+                    key = true;
+            }
+
+            return std::string();
+        }
+
+        // the string value of a key (the first one), empty if none...
+        //
+
+        std::string
+        string_value(std::string const &msg, std::string const &key)
+        {
+            auto p = msg.find('"' + key + '"');
+            if (p == std::string::npos)
+                return std::string();
+            auto b = msg.find_first_not_of(" \t", p + key.size() + 2);
+            if (b == std::string::npos || msg[b] != ':')
+                return std::string();
+            b = msg.find_first_not_of(" \t", b + 1);
+            if (b == std::string::npos || msg[b] != '"')
+                return std::string();
+            auto e = msg.find('"', b + 1);
+            return e == std::string::npos ? std::string() : msg.substr(b + 1, e - b - 1);
+        }
+
+        std::string
+        error_desc(std::string const &msg)
+        {
+            auto p = msg.find("\"desc\"");
+            if (p == std::string::npos)
+                return msg;
+            auto b = msg.find('"', msg.find(':', p) + 1);
+            auto e = msg.find('"', b + 1);
+            return (b == std::string::npos || e == std::string::npos) ? msg : msg.substr(b + 1, e - b - 1);
+        }
+
+        void
+        fail(connection &c, std::string err)
+        {
+            c.st = connection::state::failed;
+            c.error = std::move(err);
+        }
+
+        void
+        send(connection &c, std::string const &cmd)
+        {
+            c.out += cmd;
+            c.out += '\n';
+        }
+
+        bool
+        open(connection &c)
+        {
+            sockaddr_un sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sun_family = AF_UNIX;
+
+            if (c.s->path.size() >= sizeof(sa.sun_path))
+                return fail(c, "socket path too long"), false;
+
+            strncpy(sa.sun_path, c.s->path.c_str(), sizeof(sa.sun_path) - 1);
+
+            c.fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (c.fd < 0)
+                return fail(c, std::string("socket: ") + strerror(errno)), false;
+
+            if (::connect(c.fd, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0 &&
+                errno != EINPROGRESS && errno != EAGAIN)
+                return fail(c, c.s->path + ": " + strerror(errno)), false;
+
+            return true;
+        }
+
+        // send the next command, if any...
+        //
+
+        void
+        next(connection &c)
+        {
+            if (c.next == c.s->cmds.size()) {
+                c.st = connection::state::done;
+                return;
+            }
+            send(c, c.s->cmds[c.next++].json);
+            c.deleted = false;
+            c.st = connection::state::command;
+        }
+
+        // handle a complete message from the server...
+        //
+
+        void
+        handle(connection &c, std::string const &msg)
+        {
+            auto kind = message_kind(msg);
+
+            if (kind == "event")
+            {
+                // the event may come before the return of device_del...
+
+                if ((c.st == connection::state::command || c.st == connection::state::deleting) &&
+                    !c.s->cmds[c.next - 1].deleted.empty() &&
+                    string_value(msg, "event") == "DEVICE_DELETED" &&
+                    string_value(msg, "device") == c.s->cmds[c.next - 1].deleted)
+                {
+                    c.deleted = true;
+                    if (c.st == connection::state::deleting)
+                        next(c);
+                }
+                return;
+            }
+
+            if (kind == "error")
+                return fail(c, error_desc(msg));
+
+            switch(c.st)
+            {
+            case connection::state::greeting:
+                if (kind != "QMP")
+                    return fail(c, "unexpected greeting: " + msg);
+                send(c, "{\"execute\":\"qmp_capabilities\"}");
+                c.st = connection::state::capabilities;
+                break;
+
+            case connection::state::capabilities:
+            case connection::state::command:
+                if (kind != "return")
+                    return fail(c, "unexpected message: " + msg);
+                if (c.st == connection::state::command && !c.s->cmds[c.next - 1].deleted.empty() && !c.deleted) {
+                    c.st = connection::state::deleting;
+                    break;
+                }
+                next(c);
+                break;
+
+            default:
+                return fail(c, "unexpected message: " + msg);
+            }
+        }
+
+        void
+        on_read(connection &c)
+        {
+            char buf[4096];
+
+            for(;;)
+            {
+                auto n = ::read(c.fd, buf, sizeof(buf));
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    if (errno != EAGAIN && errno != EWOULDBLOCK)
+                        fail(c, std::string("read: ") + strerror(errno));
+                    break;
+                }
+                if (n == 0)
+                {
+                    fail(c, "connection closed by peer");
+                    break;
+                }
+                c.in.append(buf, static_cast<size_t>(n));
+            }
+
+            // messages are newline separated...
+            //
+
+            size_t pos;
+            while (c.st != connection::state::failed && (pos = c.in.find('\n')) != std::string::npos)
+            {
+                auto msg = c.in.substr(0, pos);
+                c.in.erase(0, pos + 1);
+                if (msg.find_first_not_of(" \r\t") != std::string::npos)
+                    handle(c, msg);
+            }
+        }
+
+        void
+        on_write(connection &c)
+        {
+            while (!c.out.empty())
+            {
+                auto n = ::write(c.fd, c.out.data(), c.out.size());
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    if (errno != EAGAIN && errno != EWOULDBLOCK)
+                        fail(c, std::string("write: ") + strerror(errno));
+                    return;
+                }
+                c.out.erase(0, static_cast<size_t>(n));
+            }
+        }
+
+        std::string
+        json_string(std::string const &s)
+        {
+            std::string ret("\"");
+            for(auto c : s)
+            {
+                if (c == '"' || c == '\\')
+                    ret += '\\';
+                ret += c;
+            }
+            return ret + '"';
+        }
+    }
+
+    /////////// public functions...
+
+    size_t run(std::vector<session> const &ss, int timeout_ms, size_t max_conn)
+    {
+        std::vector<connection> conns;
+        conns.reserve(ss.size());
+
+        size_t next = 0, failed = 0;
+        std::vector<size_t> active;
+
+        auto finish = [&](connection &c)
+        {
+            if (c.fd >= 0)
+                ::close(c.fd);
+            c.fd = -1;
+
+            if (c.st == connection::state::done)
+                more::print(std::cerr, "qmp: %1: %2 commands ok\n", c.s->name, c.s->cmds.size());
+            else
+            {
+                failed++;
+                more::print(std::cerr, "qmp: %1: error: %2\n", c.s->name, c.error);
+            }
+        };
+
+        while (next < ss.size() || !active.empty())
+        {
+            // open new connections...
+            //
+
+            while (next < ss.size() && active.size() < max_conn)
+            {
+                conns.push_back(connection{&ss[next++], -1, connection::state::greeting, 0, false,
+                                           std::string(), std::string(), std::string(),
+                                           clock_type::now() + std::chrono::milliseconds(timeout_ms)});
+                auto & c = conns.back();
+
+                if (c.s->cmds.empty())
+                    c.st = connection::state::done, finish(c);
+                else if (!open(c))
+                    finish(c);
+                else
+                    active.push_back(conns.size() - 1);
+            }
+
+            if (active.empty())
+                continue;
+
+            std::vector<pollfd> pfds(active.size());
+            for(size_t i = 0; i < active.size(); ++i)
+            {
+                auto & c = conns[active[i]];
+                pfds[i].fd = c.fd;
+                pfds[i].events = static_cast<short>(POLLIN | (c.out.empty() ? 0 : POLLOUT));
+                pfds[i].revents = 0;
+            }
+
+            if (::poll(pfds.data(), pfds.size(), 100) < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("qmp: poll: ") + strerror(errno));
+
+            auto now = clock_type::now();
+
+            std::vector<size_t> still;
+
+            for(size_t i = 0; i < active.size(); ++i)
+            {
+                auto & c = conns[active[i]];
+
+                if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                    on_read(c);
+
+                if (c.st != connection::state::failed && !c.out.empty())
+                    on_write(c);
+
+                if (c.st != connection::state::done &&
+                    c.st != connection::state::failed && now > c.deadline)
+                    fail(c, c.st == connection::state::deleting ? "timeout waiting for DEVICE_DELETED of " + c.s->cmds[c.next - 1].deleted : "timeout");
+
+                if (c.st == connection::state::done ||
+                    c.st == connection::state::failed)
+                    finish(c);
+                else
+                    still.push_back(active[i]);
+            }
+
+            active.swap(still);
+        }
+
+        return failed;
+    }
+
+
+    std::vector<std::pair<std::string, std::string>> new_nics(std::vector<Port> const &before,
+                                                              std::vector<Port> const &after,
+                                                              SwitchMap const &sm)
+    {
+        std::set<std::string> old_ids;
+
+        for(size_t n = 0; n < before.size(); ++n)
+            old_ids.insert(nic_id(before, n));
+
+        std::vector<std::pair<std::string, std::string>> ret;
+
+        for(size_t n = 0; n < after.size(); ++n)
+        {
+            auto id = nic_id(after, n);
+            if (old_ids.count(id))
+                continue;
+
+            auto it = sm.find(port_linkname(after[n]));
+            if (it == std::end(sm))
+                throw std::runtime_error("hotplug: switch " + port_linkname(after[n]) + " not found");
+
+            if (node_type(get_switch(it->second)) != switch_type::bridge)
+                throw std::runtime_error("hotplug: " + show(node_type(get_switch(it->second))) + " switch " + it->first + " not supported");
+
+            ret.emplace_back(id, it->first);
+        }
+
+        return ret;
+    }
+
+
+    std::vector<command> make_hotplug(std::vector<Port> const &before,
+                                      std::vector<Port> const &after,
+                                      std::map<std::string, std::string> const &taps)
+    {
+        std::set<std::string> old_ids, new_ids;
+
+        for(size_t n = 0; n < before.size(); ++n)
+            old_ids.insert(nic_id(before, n));
+        for(size_t n = 0; n < after.size(); ++n)
+            new_ids.insert(nic_id(after, n));
+
+        std::vector<command> ret;
+
+        // removed NICs...
+        //
+
+        for(size_t n = 0; n < before.size(); ++n)
+        {
+            auto id = nic_id(before, n);
+            if (new_ids.count(id))
+                continue;
+
+            ret.push_back(command{more::sprint("{\"execute\":\"device_del\",\"arguments\":{\"id\":%1}}", json_string("nic-" + id)), "nic-" + id});
+            ret.push_back(command{more::sprint("{\"execute\":\"netdev_del\",\"arguments\":{\"id\":%1}}", json_string("net-" + id)), std::string()});
+        }
+
+        // new NICs...
+        //
+
+        for(size_t n = 0; n < after.size(); ++n)
+        {
+            auto id = nic_id(after, n);
+            if (old_ids.count(id))
+                continue;
+
+            auto tap = taps.find(id);
+            if (tap == std::end(taps))
+                throw std::logic_error("hotplug: no tap for " + id);
+
+            ret.push_back(command{more::sprint("{\"execute\":\"netdev_add\",\"arguments\":{\"type\":\"tap\",\"id\":%1,\"ifname\":%2,\"script\":\"no\",\"downscript\":\"no\"}}",
+                                               json_string("net-" + id), json_string(tap->second)), std::string()});
+            ret.push_back(command{more::sprint("{\"execute\":\"device_add\",\"arguments\":{\"driver\":\"virtio-net-pci\",\"netdev\":%1,\"id\":%2}}",
+                                               json_string("net-" + id), json_string("nic-" + id)), std::string()});
+        }
+
+        return ret;
+    }
+
+    } // namespace qmp
+}
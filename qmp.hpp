@@ -0,0 +1,66 @@
+#pragma once
+
+#include <network.hpp>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace topo
+{
+    namespace qmp
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // a QMP session: the commands (JSON) to run, in order, on the QMP
+        // socket of a VM.
+        //
+
+        // a command and, for device_del (asynchronous: the guest has to
+        // release the device), the device whose DEVICE_DELETED event
+        // completes it...
+        //
+
+        struct command
+        {
+            std::string json;
+            std::string deleted;
+        };
+
+        struct session
+        {
+            std::string name;
+            std::string path;
+            std::vector<command> cmds;
+        };
+
+        // run the sessions concurrently from a single thread (at most
+        // max_conn sockets open at once); each session must complete
+        // within timeout_ms. Returns the number of failed sessions.
+        //
+
+        size_t run(std::vector<session> const &ss, int timeout_ms = 10000, size_t max_conn = 256);
+
+        // the NICs of 'after' that are not in 'before' (matched by nic_id)
+        // and their bridge; other switch types cannot be hot-plugged...
+        //
+
+        std::vector<std::pair<std::string, std::string>> new_nics(std::vector<Port> const &before,
+                                                                  std::vector<Port> const &after,
+                                                                  SwitchMap const &sm);
+
+        // QMP commands that turn the NICs of a running VM from the ports
+        // 'before' into the ports 'after': the removed NICs are deleted
+        // (the netdev once the device is gone), the new ones get a tap
+        // netdev on the tap given for their nic_id in 'taps', created and
+        // enslaved to the bridge beforehand, as the VM NICs of the plan.
+        //
+
+        std::vector<command> make_hotplug(std::vector<Port> const &before,
+                                          std::vector<Port> const &after,
+                                          std::map<std::string, std::string> const &taps);
+
+    } // namespace qmp
+
+} // namespace topo
@@ -1,8 +1,11 @@
 #include <script.hpp>
-#include <global.hpp>
 
+#include <algorithm>
+#include <exception>
 #include <iostream>
+#include <iterator>
 #include <sstream>
+#include <thread>
 
 #include <show.hpp>
 #include <print.hpp>
@@ -13,22 +16,154 @@ namespace topo
    
     namespace
     {
+        // VALE switches: netmap wants the switch name to begin with "vale",
+        // ports are persistent netmap interfaces named after the global
+        // port index (vpN), attached as <switch>:vpN. The VMs open them by
+        // their own name (<switch>:vpN would attach the port again).
+        //
+
+        const int vale_max_ports = 254;
+
+        line
+        make_vale_cmdline(std::string const &name,
+                          int base,
+                          int n_if)
+        {
+            if (n_if > vale_max_ports)
+                throw std::runtime_error("vale: switch " + name + " has too many ports (max " + std::to_string(vale_max_ports) + ")");
+
+            auto sw = vale_switch_name(name);
+
+            static const more::format vale_port("vale-ctl -n %1 && vale-ctl -a %2");
+
+            std::string cmds;
+
+            for(int i = base; i < base + n_if; ++i)
+            {
+                if (i != base)
+                    cmds += " && ";
+                vale_port.append(cmds, vale_port_name(i), shell_quote(sw + ":" + vale_port_name(i)));
+            }
+
+            if (n_if <= 0)
+                cmds += "true";
+
+            return shell_cmd(cmds);
+        }
+
+        // vhost-user switches: no host device, the switch only gets the
+        // directory of the sockets (created by qemu, server side) and the
+        // port map to attach them...
+        //
+
+        // absolute path of a socket, the same in the port map and for qemu
+        // (expanded by the shell running the plan)...
+        //
+
+        bool
+        is_relative(std::string const &path)
+        {
+            return path.empty() || path[0] != '/';
+        }
+
+        std::string
+        vhost_socket_path(context const &ctx, int index)
+        {
+            return (is_relative(ctx.vhost_dir) ? "$PWD/" : "") + vhost_socket(ctx, index);
+        }
+
+        // a path as a shell word, relative ones made absolute: "$PWD/p",
+        // or "$PWD/"'p' if p has to be quoted...
+        //
+
+        std::string
+        absolute_word(std::string const &path)
+        {
+            auto word = shell_quote(path);
+
+            if (!is_relative(path))
+                return word;
+
+            return word == path ? "\"$PWD/" + path + "\"" : "\"$PWD/\"" + word;
+        }
+
         line
-        make_bridge_cmdline(std::string const &name,
+        make_vhostuser_cmdline(context const &ctx,
+                               std::string const &name,
+                               int base,
+                               int n_if)
+        {
+            static const more::format port(" %1 %2");
+
+            std::string ports;
+            for(int i = base; i < base + n_if; ++i)
+                port.append(ports, vhost_port_name(i), absolute_word(vhost_socket(ctx, i)));
+
+            if (n_if <= 0)
+                return shell_cmd(more::sprint("mkdir -p %1 && : > %2", shell_quote(ctx.vhost_dir), shell_quote(vhost_port_map(ctx, name))));
+
+            return shell_cmd(more::sprint("mkdir -p %1 && printf \"%%s %%s\\n\"%2 > %3",
+                                          shell_quote(ctx.vhost_dir), ports, shell_quote(vhost_port_map(ctx, name))));
+        }
+
+        line
+        make_bridge_cmdline(context const &ctx,
+                            std::string const &name,
                             topo::switch_type t,
                             int base,
-                            int n_if)
+                            int n_if,
+                            std::set<int> const &mq)
         {
             std::string opt_type;
             switch(t)
             {
-            case topo::switch_type::bridge:   opt_type = more::sprint("-B %1", name); break;
+            case topo::switch_type::bridge:   opt_type = "-B " + name; break;
             case topo::switch_type::macvtap:  break;
             case topo::switch_type::macvtap2: opt_type = "-2"; break;
+            case topo::switch_type::vale:     return make_vale_cmdline(name, base, n_if);
+            case topo::switch_type::vhostuser: return make_vhostuser_cmdline(ctx, name, base, n_if);
+            case topo::switch_type::p2p:      return line();      // no host device
             default: throw std::runtime_error("make_bridge_cmdline: internal error");
             }
 
-            return more::sprint("vnet-setup.sh %1 -z -m %2 -n %3", opt_type, base, n_if);
+            // multiqueue taps (IFF_MULTI_QUEUE) of this switch...
+            //
+
+            std::string mq_opt;
+
+            for(auto it = mq.lower_bound(base); it != std::end(mq) && *it < base + n_if; ++it)
+            {
+                mq_opt += mq_opt.empty() ? " -q \"" : " ";
+                mq_opt += std::to_string(*it);
+            }
+
+            if (!mq_opt.empty())
+                mq_opt += '"';
+
+            static const more::format vnet_setup("vnet-setup.sh %1 -z -m %2 -n %3%4");
+
+            return vnet_setup(opt_type, base, n_if, mq_opt);
+        }
+
+
+        // netem options of a port: " delay 20ms 5ms loss 0.1% rate 10mbit"
+        //
+
+        std::string
+        make_netem_opt(LinkConf const &c)
+        {
+            std::string ret;
+
+            if (!link_delay(c).empty())
+                ret += " delay " + link_delay(c);
+            if (!link_jitter(c).empty())
+                ret += ' ' + link_jitter(c);
+            if (!link_loss(c).empty())
+                ret += " loss " + link_loss(c);
+            if (!link_rate(c).empty())
+                ret += " rate " + link_rate(c);
+
+            return ret;
         }
 
 
@@ -39,10 +174,265 @@ namespace topo
         }
 
 
+        // overlays: <overlay_dir>/<node>.qcow2, backed by the shared base
+        // image (relative base paths are made absolute, as qemu-img resolves
+        // them relative to the overlay), whose format (qcow2, raw...) is
+        // read by qemu-img info. An existing overlay holds the state of the
+        // guest: it is kept, not created again...
+        //
+
+        std::string
+        overlay_path(context const &ctx, std::string const &name)
+        {
+            return ctx.overlay_dir + "/" + name + ".qcow2";
+        }
+
+        line
+        make_overlay_cmdline(context const &ctx, std::string const &name, opt::image_type const &image)
+        {
+            auto base = image.args.at(0);
+
+            if (base.size() > 1 && base.front() == '"' && base.back() == '"')
+                base = base.substr(1, base.size() - 2);
+
+            if (base.empty())
+                throw std::runtime_error("overlay: " + name + ": base image missing");
+
+            static const more::format overlay("mkdir -p %1 && if [ -e %3 ]; then echo overlay: %3 exists, kept >&2; "
+                                              "else F=$(qemu-img info %2 | sed -n \"s/^file format: //p\") && [ -n \"$F\" ] && "
+                                              "qemu-img create -q -f qcow2 -F $F -b %2 %3; fi");
+
+            return shell_cmd(overlay(shell_quote(ctx.overlay_dir),
+                                     absolute_word(base),
+                                     shell_quote(overlay_path(ctx, name))));
+        }
+
+
+        // virtio-net offload flags: "csum,gso,-guest_ufo" -> ",csum=on,gso=on,guest_ufo=off"
+        //
+
+        std::string
+        make_offload_opt(std::string const &flags)
+        {
+            std::string ret;
+            std::istringstream in(flags);
+            std::string f;
+
+            while (std::getline(in, f, ','))
+            {
+                if (f.empty())
+                    continue;
+                if (f[0] == '-')
+                    ret += ',' + f.substr(1) + "=off";
+                else
+                    ret += ',' + f + "=on";
+            }
+
+            return ret;
+        }
+
+        std::string
+        make_tap_nic(std::string const &id, std::string const &dev_id, int tap, NicConf const &c)
+        {
+            static const more::format tap_netdev("-netdev tap,id=%1,ifname=tap%2,script=no,downscript=no");
+            static const more::format tap_device("-device virtio-net-pci,netdev=%1%2");
+
+            std::string netdev = tap_netdev(id, tap);
+            std::string device = tap_device(id, dev_id);
+
+            if (nic_queues(c) > 1)
+            {
+                netdev += ",queues=" + std::to_string(nic_queues(c));
+                device += ",mq=on,vectors=" + std::to_string(2 * nic_queues(c) + 2);
+            }
+
+            if (nic_vhost(c))
+                netdev += ",vhost=on";
+
+            return netdev + ' ' + device + make_offload_opt(nic_offload(c));
+        }
+
+        // vhost-user NIC: qemu is the server of the socket (the switch can
+        // be restarted), wait=off not to block the boot on the switch...
+        //
+
+        std::string
+        make_vhostuser_nic(context const &ctx, std::string const &id, std::string const &dev_id, int port, NicConf const &c)
+        {
+            static const more::format vhost_netdev("-chardev socket,id=chr-%1,path=%2,server=on,wait=off "
+                                                   "-netdev vhost-user,id=%1,chardev=chr-%1");
+            static const more::format vhost_device("-device virtio-net-pci,netdev=%1%2");
+
+            std::string netdev = vhost_netdev(id, vhost_socket_path(ctx, port));
+            std::string device = vhost_device(id, dev_id);
+
+            if (nic_queues(c) > 1)
+            {
+                netdev += ",queues=" + std::to_string(nic_queues(c));
+                device += ",mq=on,vectors=" + std::to_string(2 * nic_queues(c) + 2);
+            }
+
+            return netdev + ' ' + device + make_offload_opt(nic_offload(c));
+        }
+
+        // p2p NIC: a UDP socket netdev on the loopback (single queue), bound
+        // to the port of its own index and sending to the one of the peer
+        // (the other port of the switch)...
+        //
+
+        int
+        p2p_udp_port(context const &ctx, int index)
+        {
+            auto port = ctx.p2p_port + index;
+            if (port <= 0 || port > 65535)
+                throw std::runtime_error("p2p: UDP port " + std::to_string(port) + " out of range (see --p2p-port)");
+            return port;
+        }
+
+        std::string
+        make_p2p_nic(context const &ctx, std::string const &id, std::string const &dev_id, int port, SwitchInfo const &sw, NicConf const &c)
+        {
+            static const more::format p2p_nic("-netdev socket,id=%1,udp=127.0.0.1:%2,localaddr=127.0.0.1:%3 "
+                                              "-device virtio-net-pci,netdev=%1%4%5");
+
+            auto base = get_base(sw);
+            auto peer = port == base ? base + 1 : base;
+
+            return p2p_nic(id, p2p_udp_port(ctx, peer), p2p_udp_port(ctx, port), dev_id, make_offload_opt(nic_offload(c)));
+        }
+
+        // NIC options: taps are passed to startmv.sh with -I; as soon as a
+        // node has a port on a VALE, vhost-user or p2p switch or a tuned NIC,
+        // all of its NICs are passed as qemu netdev/device pairs with -Q, to
+        // preserve the port order. The vCPU count and the memory, if set, go
+        // to -Q as well. With vhost-user NICs the guest memory is shared
+        // hugepages, which the switch maps: its size must be set (mem).
+        //
+        // With a QMP directory, every VM gets its QMP socket and NICs with
+        // stable ids (net-<nic_id>, nic-<nic_id>), so that they can be
+        // hot-plugged later.
+        //
+
+        line
+        make_nic_opt(context const &ctx,
+                     std::string const &node,
+                     std::vector<Port> const &ports,
+                     SwitchMap const &sm,
+                     Settings const &st,
+                     std::vector<int> const &ts)
+        {
+            if (ports.size() != ts.size())
+                throw std::logic_error("make_nic_opt: internal error");
+
+            std::vector<SwitchInfo const *> sws;
+            std::vector<switch_type> types;
+            std::vector<NicConf> confs;
+            bool taps_only = true;
+            bool vhostuser = false;
+
+            for(auto & p : ports)
+            {
+                auto it = sm.find(port_linkname(p));
+                if (it == std::end(sm))
+                    throw std::logic_error("make_nic_opt: switch " + port_linkname(p) + " not found");
+
+                sws.push_back(&it->second);
+                types.push_back(node_type(get_switch(it->second)));
+                confs.push_back(nic_conf(st, node, confs.size()));
+
+                taps_only = taps_only && types.back() != switch_type::vale && types.back() != switch_type::vhostuser &&
+                            types.back() != switch_type::p2p && nic_is_default(confs.back());
+                vhostuser = vhostuser || types.back() == switch_type::vhostuser;
+            }
+
+            auto & qmp = ctx.qmp;
+
+            if (!qmp.empty())
+                taps_only = false;
+
+            auto smp = node_smp(st, node);
+
+            std::string opt;
+
+            if (smp > 1)
+                opt = "-smp " + std::to_string(smp);
+
+            auto mem = node_mem(st, node);
+
+            if (vhostuser && mem == 0)
+                throw std::runtime_error("vhostuser: " + node + ": mem must be set (guest memory shared with the switch)");
+
+            if (mem > 0)
+                opt += more::sprint("%1-m %2", opt.empty() ? "" : " ", mem);
+
+            if (vhostuser)
+                opt += more::sprint(" -object memory-backend-file,id=mem,size=%1M,mem-path=%2,share=on -numa node,memdev=mem",
+                                    mem, ctx.hugepages);
+
+            if (!qmp.empty())
+                opt += more::sprint("%1-qmp unix:%2/%3.sock,server=on,wait=off", opt.empty() ? "" : " ", qmp, node);
+
+            if (taps_only)
+            {
+                if (!opt.empty())
+                    opt = " -Q \"" + opt + "\"";
+
+                std::string taps;
+                auto t = std::begin(ts);
+
+                do 
+                {
+                    taps += "tap" + std::to_string(*t++);
+                }
+                while (t != std::end(ts) ? (taps += ' ', true) : false);
+
+                return "-I \"" + taps + "\"" + opt;
+            }
+
+            for(size_t n = 0; n < ts.size(); ++n)
+            {
+                if (!opt.empty())
+                    opt += ' ';
+
+                auto id     = qmp.empty() ? "net" + std::to_string(n) : "net-" + nic_id(ports, n);
+                auto dev_id = qmp.empty() ? std::string() : ",id=nic-" + nic_id(ports, n);
+
+                if (types[n] == switch_type::vale)
+                {
+                    auto pt = ctx.ptnetmap;
+
+                    static const more::format netmap_nic("-netdev netmap,id=%1,ifname=%2%3 -device %4,netdev=%1%5");
+
+                    netmap_nic.append(opt, id, vale_port_name(ts[n]),
+                                      pt ? ",passthrough=on" : "",
+                                      pt ? "ptnet-pci" : "virtio-net-pci",
+                                      dev_id);
+                }
+                else if (types[n] == switch_type::vhostuser)
+                {
+                    opt += make_vhostuser_nic(ctx, id, dev_id, ts[n], confs[n]);
+                }
+                else if (types[n] == switch_type::p2p)
+                {
+                    opt += make_p2p_nic(ctx, id, dev_id, ts[n], *sws[n], confs[n]);
+                }
+                else
+                {
+                    opt += make_tap_nic(id, dev_id, ts[n], confs[n]);
+                }
+            }
+
+            return "-Q \"" + opt + "\"";
+        }
+
         line
-        make_startvm_cmdline(opt::image_type const &image, 
+        make_startvm_cmdline(context const &ctx,
+                             std::string const &name,
+                             opt::image_type const &image, 
                              opt::term_type const &term,
                              std::vector<Port> const &ports,
+                             SwitchMap const &sm,
+                             Settings const &st,
                              std::string const &vmlinuz, 
                              std::string const &core, 
                              std::vector<int> const &ts)
@@ -50,55 +440,106 @@ namespace topo
             if (ts.empty())
                 throw std::logic_error("make_startvm_cmdline: no taps available");
             
-            std::string tap_opt;
-
-            auto t = std::begin(ts);
-
-            do 
-            {
-                tap_opt += "tap" + std::to_string(*t++);
-            }
-            while (t != std::end(ts) ? (tap_opt += ' ', true) : false);
+            auto nic_opt = make_nic_opt(ctx, name, ports, sm, st, ts);
 
             // append extra flags to guest kernel...
             //
             
             std::string append;
-            if (global::instance().append_ip && !ports.empty())
+            if (ctx.append_ip && !ports.empty())
             {
-                append += "-a ifaces=";
+                static const more::format iface("%1eth%2-%3");
 
-                auto it = std::begin(ports);
-                auto it_e = std::end(ports);
-                
-                int n = 0;
+                append.reserve(10 + ports.size() * (8 + net::format_buffer_size));
+                append += "-a ifaces=";
 
-                do 
-                {
-                    append += "eth" + std::to_string(n) + "-" +  show(it->first); 
-                    ++it; ++n;
-                }
-                while([&]() -> bool 
-                {
-                    return it != it_e ? (append += ",", true) : false;
-                }()); 
+                for(size_t n = 0; n < ports.size(); ++n)
+                    iface.append(append, n ? "," : "", n, port_address(ports[n]));
             }
 
-            return more::sprint("startmv.sh -k -n %1 -I \"%2\" %3 -l %4 -c %5 %7 </dev/zero &>log-%6.txt &",
-                                    term,
-                                    tap_opt,
-                                    image,
-                                    vmlinuz,
-                                    core,
-                                    term.args[0],
-                                    append
-                                    );
+            // the script starts the VMs in background; with --execute the
+            // shell is replaced by startmv.sh, so that exec::pool follows
+            // the VM itself (its exit status, its pid)...
+
+            static const more::format startvm("startmv.sh -k -n %1 %2 %3 -l %4 -c %5 %7 </dev/zero &>%6 &");
+            static const more::format startvm_exec("exec sh startmv.sh -k -n %1 %2 %3 -l %4 -c %5 %7 </dev/zero >%6 2>&1");
+
+            auto cmd = (ctx.execute ? startvm_exec : startvm)(term,
+                           nic_opt,
+                           is_overlay(image) ? opt::image_type{"-q", {shell_quote(overlay_path(ctx, name))}} : image,
+                           shell_quote(vmlinuz),
+                           shell_quote(core),
+                           shell_quote("log-" + term.args[0] + ".txt"),
+                           append
+                           );
+
+            return ctx.execute ? shell_cmd(cmd) : cmd;
         }
     }
 
     /////////// public functions...
+
+    std::string shell_quote(std::string const &s)
+    {
+        static const std::string safe("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_@%+=:,./-");
+
+        if (!s.empty() && s.find_first_not_of(safe) == std::string::npos)
+            return s;
+
+        std::string ret("'");
+        for(auto c : s)
+        {
+            if (c == '\'')
+                ret += "'\\''";
+            else
+                ret += c;
+        }
+        return ret + "'";
+    }
+
+
+    line shell_cmd(std::string const &script)
+    {
+        return "-c " + shell_quote(script);
+    }
+
+
+    std::string vale_switch_name(std::string const &name)
+    {
+        auto ret = name.compare(0, 4, "vale") == 0 ? name : "vale" + name;
+        if (ret.size() >= 16)
+            throw std::runtime_error("vale: switch name " + ret + " too long");
+        if (ret.find(':') != std::string::npos)
+            throw std::runtime_error("vale: invalid switch name " + ret);
+        return ret;
+    }
+
+
+    std::string vale_port_name(int index)
+    {
+        return "vp" + std::to_string(index);
+    }
+
     
-    std::vector<line> make_bridges(SwitchMap ss)
+    std::string vhost_port_name(int index)
+    {
+        return "vu" + std::to_string(index);
+    }
+
+
+    std::string vhost_socket(context const &ctx, int index)
+    {
+        return ctx.vhost_dir + "/" + vhost_port_name(index) + ".sock";
+    }
+
+
+    std::string vhost_port_map(context const &ctx, std::string const &name)
+    {
+        return ctx.vhost_dir + "/" + name + ".ports";
+    }
+
+    
+    std::vector<line> make_bridges(context const &ctx, SwitchMap ss, std::set<int> const &mq)
     {
         std::vector<line> ret;
 
@@ -107,9 +548,10 @@ namespace topo
         {
             auto nlink = std::get<1>(s.second);
 
-            ret.push_back( make_bridge_cmdline(node_name(get_switch(s.second)),
+            ret.push_back( make_bridge_cmdline(ctx,
+                                               node_name(get_switch(s.second)),
                                                node_type(get_switch(s.second)),
-                                               base, nlink) ); 
+                                               base, nlink, mq) ); 
 
             base += nlink;
         }
@@ -117,38 +559,202 @@ namespace topo
         return ret;
     }
 
-    std::vector<line> make_kvm()
+    std::string initrd(context const &ctx)
+    {
+        if (ctx.initrd_cache.empty())
+            return ctx.core;
+
+        auto name = ctx.core.substr(ctx.core.rfind('/') + 1);
+
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0)
+            name.resize(name.size() - 3);
+
+        return ctx.initrd_cache + "/" + name + ".cpio";
+    }
+
+
+    std::vector<line> make_kvm(context const &ctx)
     {
         std::vector<line> ret;
 
         ret.push_back(make_kvm_setup_cmdline());
 
+        // the guests boot the cpio as is, without decompressing it...
+        //
+
+        if (!ctx.initrd_cache.empty())
+        {
+            auto cpio = initrd(ctx);
+
+            ret.push_back(shell_cmd(more::sprint("mkdir -p %1 && { [ %2 -nt %3 ] || { gzip -dc %3 > %4 && mv %4 %2; }; }",
+                                                 shell_quote(ctx.initrd_cache), shell_quote(cpio), shell_quote(ctx.core),
+                                                 shell_quote(cpio + ".tmp"))));
+        }
+
         return ret;
     }
         
     
-    std::vector<line> make_vms(Nodes const &ns, TapMap const &tm)
+    shaping make_shaping(Nodes const &ns, TapMap const &tm, SwitchMap const &sm, Settings const &st, size_t batch)
     {
-        std::vector<line> ret;
-            
-        auto & g = global::instance();
+        static const more::format tc_batch("printf \"qdisc replace dev tap%%s root netem%%s\\n\"%1 | tc -force -batch -");
+        static const more::format tc_tap(" %1 \"%2\"");
+
+        shaping ret;
+        std::string args;
+        std::vector<int> taps;
+
+        auto flush = [&]
+        {
+            ret.cmds.push_back(shell_cmd(tc_batch(args)));
+            ret.taps.push_back(std::move(taps));
+            args.clear();
+            taps.clear();
+        };
 
         for(auto & n : ns)
         {
             auto t = tm.find(node_name(n));
             if (t == std::end(tm))
-                throw std::logic_error("make_vms: internal error");
+                throw std::logic_error("make_shaping: internal error");
+
+            auto ports = node_ports(n);
+
+            for(size_t p = 0; p < ports.size(); ++p)
+            {
+                auto lc = link_conf(st, port_linkname(ports[p]), node_name(n), p);
+                if (link_is_default(lc))
+                    continue;
+
+                auto it = sm.find(port_linkname(ports[p]));
+                if (it == std::end(sm))
+                    throw std::logic_error("make_shaping: switch " + port_linkname(ports[p]) + " not found");
+
+                auto type = node_type(get_switch(it->second));
+                if (type == switch_type::vale || type == switch_type::vhostuser || type == switch_type::p2p)
+                    throw std::runtime_error(more::sprint("shaping: %1:%2: %3 switch %4 has no tap", node_name(n), p, type, it->first));
+
+                tc_tap.append(args, t->second[p], make_netem_opt(lc));
+                taps.push_back(t->second[p]);
+
+                if (taps.size() == batch)
+                    flush();
+            }
+        }
+
+        if (!taps.empty())
+            flush();
+
+        return ret;
+    }
+
+
+    std::string log_file(Node const &n)
+    {
+        return "log-" + node_term(n).args.at(0) + ".txt";
+    }
+
+
+    std::vector<line> make_overlays(context const &ctx, Nodes const &ns)
+    {
+        std::vector<line> ret;
+
+        for(auto & n : ns)
+        {
+            ret.push_back(is_overlay(node_image(n)) ? make_overlay_cmdline(ctx, node_name(n), node_image(n))
+                                                    : line());
+        }
+
+        return ret;
+    }
+
+
+    std::vector<line> make_vms(context const &ctx, Nodes const &ns, TapMap const &tm, SwitchMap const &sm, Settings const &st)
+    {
+        auto core = initrd(ctx);
 
-            g.index++;
+        // append the lines of the nodes [first, last) to out...
+        //
+
+        auto make_range = [&](size_t first, size_t last, std::vector<line> &out)
+        {
+            out.reserve(out.size() + last - first);
+
+            for(auto i = first; i < last; ++i)
+            {
+                auto & n = ns[i];
 
-            ret.push_back(make_startvm_cmdline(node_image(n), 
-                                               node_term(n),
-                                               node_ports(n),
-                                               g.kernel,
-                                               g.core,
-                                               t->second));
+                auto t = tm.find(node_name(n));
+                if (t == std::end(tm))
+                    throw std::logic_error("make_vms: internal error");
+
+                out.push_back(make_startvm_cmdline(ctx,
+                                                   node_name(n),
+                                                   node_image(n), 
+                                                   node_term(n),
+                                                   node_ports(n),
+                                                   sm,
+                                                   st,
+                                                   ctx.kernel,
+                                                   core,
+                                                   t->second));
+            }
+        };
+
+        // at least min_range nodes per thread...
+        //
+
+        const size_t min_range = 4096;
+
+        size_t nt = ctx.threads > 0 ? static_cast<size_t>(ctx.threads) : std::max(std::thread::hardware_concurrency(), 1u);
+
+        nt = std::min(nt, ns.size() / min_range);
+
+        std::vector<line> ret;
+
+        if (nt <= 1)
+        {
+            make_range(0, ns.size(), ret);
+            return ret;
+        }
+
+        // each thread builds its range into a buffer of its own (nothing
+        // written is shared), the buffers are then spliced in node order;
+        // the error of the first range that fails is the one the
+        // sequential version would throw...
+        //
+
+        std::vector<std::vector<line>> buf(nt);
+        std::vector<std::exception_ptr> errors(nt);
+        std::vector<std::thread> pool;
+
+        for(size_t n = 0; n < nt; ++n)
+        {
+            pool.emplace_back([&, n]
+            {
+                try
+                {
+                    make_range(ns.size() * n / nt, ns.size() * (n + 1) / nt, buf[n]);
+                }
+                catch(...)
+                {
+                    errors[n] = std::current_exception();
+                }
+            });
         }
 
+        for(auto & t : pool)
+            t.join();
+
+        for(auto & e : errors)
+            if (e)
+                std::rethrow_exception(e);
+
+        ret.reserve(ns.size());
+
+        for(auto & b : buf)
+            std::move(std::begin(b), std::end(b), std::back_inserter(ret));
+
         return ret;
     }
 
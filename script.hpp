@@ -1,10 +1,12 @@
 #pragma once 
 
 #include <network.hpp>
+#include <context.hpp>
 
 #include <iostream>
 #include <string>
 #include <vector>
+#include <set>
 
 namespace topo 
 {
@@ -12,19 +14,83 @@ namespace topo
     {
         typedef std::string line;
 
-        std::vector<line> make_bridges(SwitchMap ss);
+        // a word for the shell: as is when made of safe characters only,
+        // otherwise single-quoted (with ' as '\'')...
+        //
 
-        std::vector<line> make_kvm();
+        std::string shell_quote(std::string const &s);
 
-    	std::vector<line> make_vms(Nodes const &ns, TapMap const &tm);
+        // the line running a shell script: "-c <quoted script>" (the
+        // values in the script quoted by shell_quote)...
+        //
 
-        inline void show(std::vector<std::string> const &script)
+        line shell_cmd(std::string const &script);
+
+        // VALE names: switch (prefixed with "vale") and port vpN...
+        //
+
+        std::string vale_switch_name(std::string const &name);
+
+        std::string vale_port_name(int index);
+
+        // vhost-user: socket of the port with global index N (<vhost_dir>/vuN.sock),
+        // port map of a switch (<vhost_dir>/<switch>.ports: one "vuN <socket>"
+        // line per port, the sockets to attach to the userspace switch)...
+        //
+
+        std::string vhost_port_name(int index);
+
+        std::string vhost_socket(context const &ctx, int index);
+
+        std::string vhost_port_map(context const &ctx, std::string const &name);
+
+        std::vector<line> make_bridges(context const &ctx, SwitchMap ss, std::set<int> const &mq = std::set<int>());
+
+        // kvm setup, then, with an initrd cache, the command decompressing
+        // the initramfs into it (if missing or older than ctx.core)...
+        //
+
+        std::vector<line> make_kvm(context const &ctx);
+
+        // initramfs given to the VMs: ctx.core, or its uncompressed copy
+        // <initrd_cache>/<core without .gz>.cpio
+        //
+
+        std::string initrd(context const &ctx);
+
+        // link shaping (delay, jitter, loss and rate settings, see
+        // link_conf): a netem qdisc on the tap of each shaped port,
+        // installed by tc -batch with up to 'batch' taps per command.
+        // taps[i] are the taps shaped by cmds[i]. Ports of VALE,
+        // vhost-user and p2p switches have no tap and cannot be shaped.
+        //
+
+        struct shaping
         {
-            for(auto & line : script)
-            {
-                std::cout << "sh " << line << std::endl;
-            }
-        }
+            std::vector<line> cmds;
+            std::vector<std::vector<int>> taps;
+        };
+
+        shaping make_shaping(Nodes const &ns, TapMap const &tm, SwitchMap const &sm, Settings const &st, size_t batch = 512);
+
+        // one line per node: the command creating its qcow2 overlay, or
+        // an empty line if the node runs on its own image...
+        //
+
+        std::vector<line> make_overlays(context const &ctx, Nodes const &ns);
+
+        // console log of the node (written by startmv.sh)...
+        //
+
+        std::string log_file(Node const &n);
+
+        // one line per node, in node order. With ctx.threads > 1 the nodes
+        // are split in ranges, each built on its own thread into its own
+        // buffer, then spliced (large topologies only); the lines are the
+        // same as the sequential ones.
+        //
+
+    	std::vector<line> make_vms(context const &ctx, Nodes const &ns, TapMap const &tm, SwitchMap const &sm, Settings const &st = Settings());
     }
 
 } // namespace topo
@@ -0,0 +1,454 @@
+#include <server.hpp>
+#include <builder.hpp>
+#include <parser/basic.hpp>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <print.hpp>
+
+namespace topo
+{
+    namespace server {
+
+    namespace
+    {
+        const size_t max_request = 256 << 20;
+
+        struct topology
+        {
+            Switches switches;
+            Nodes nodes;
+            Settings settings;
+        };
+
+        typedef std::shared_ptr<topology const> topology_ptr;
+
+        topology_ptr
+        parse(std::string const &name, std::string const &content)
+        {
+            std::istringstream sc(content);
+            more::details::streambuf sb(sc.rdbuf(), '#');
+            std::istream in(&sb);
+
+            more::parser_options mode = more::key_value_opt::non_strict().separator('=').comment('#');
+            std::get<more::target_name>(mode) = name;
+
+            basic::parser::type config;
+
+            if (!config.load(in, mode))
+                throw std::runtime_error("parse error in config file!");
+
+            return std::make_shared<topology>(topology{ std::move(more::get<basic::parser::switches>(config)),
+                                                        std::move(more::get<basic::parser::nodes>(config)),
+                                                        std::move(more::get<basic::parser::settings>(config)) });
+        }
+
+        //
+        // the parsed topologies, by content hash (least recently used
+        // evicted first). A config is parsed once: concurrent requests
+        // for the same content wait for the first one...
+        //
+
+        class cache
+        {
+            struct entry
+            {
+                std::string content;
+                std::shared_future<topology_ptr> topo;
+                std::list<size_t>::iterator lru;
+                unsigned long id;
+            };
+
+        public:
+            explicit cache(size_t size)
+            : size_(size)
+            , next_id_(0)
+            {}
+
+            topology_ptr
+            get(std::string const &name, std::string const &content, bool &hit)
+            {
+                hit = false;
+
+                if (size_ == 0)
+                    return parse(name, content);
+
+                auto key = std::hash<std::string>()(content);
+
+                std::promise<topology_ptr> p;
+                std::shared_future<topology_ptr> f;
+                unsigned long id;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+
+                    auto it = map_.find(key);
+                    if (it != std::end(map_) && it->second.content == content)
+                    {
+                        lru_.splice(std::begin(lru_), lru_, it->second.lru);
+                        f = it->second.topo;
+                        hit = true;
+                    }
+                    else
+                    {
+                        if (it != std::end(map_))       // hash collision
+                        {
+                            lru_.erase(it->second.lru);
+                            map_.erase(it);
+                        }
+
+                        f = p.get_future().share();
+                        id = next_id_++;
+
+                        lru_.push_front(key);
+                        map_[key] = entry{content, f, std::begin(lru_), id};
+
+                        while (map_.size() > size_)
+                        {
+                            map_.erase(lru_.back());
+                            lru_.pop_back();
+                        }
+                    }
+                }
+
+                if (hit)
+                    return f.get();
+
+                try
+                {
+                    p.set_value(parse(name, content));
+                }
+                catch(...)
+                {
+                    p.set_exception(std::current_exception());
+
+                    // do not keep the failure...
+                    //
+
+                    std::lock_guard<std::mutex> lock(mutex_);
+
+                    auto it = map_.find(key);
+                    if (it != std::end(map_) && it->second.id == id)
+                    {
+                        lru_.erase(it->second.lru);
+                        map_.erase(it);
+                    }
+                }
+
+                return f.get();
+            }
+
+        private:
+            std::mutex mutex_;
+            size_t size_;
+            unsigned long next_id_;
+            std::list<size_t> lru_;                 // most recent first
+            std::unordered_map<size_t, entry> map_;
+        };
+
+
+        std::string
+        read_file(std::string const &path)
+        {
+            std::ifstream in(path);
+            if (!in)
+                throw std::runtime_error(path + ": no such file");
+
+            std::ostringstream ss;
+            ss << in.rdbuf();
+            return ss.str();
+        }
+
+        // the whole request, up to the end of the stream...
+        //
+
+        std::string
+        read_request(int fd)
+        {
+            std::string ret;
+            char buf[65536];
+            ssize_t n;
+
+            while ((n = ::read(fd, buf, sizeof(buf))) != 0)
+            {
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    throw std::runtime_error(std::string("read: ") + strerror(errno));
+                }
+
+                ret.append(buf, static_cast<size_t>(n));
+
+                if (ret.size() > max_request)
+                    throw std::runtime_error("request too large");
+            }
+
+            return ret;
+        }
+
+        void
+        write_all(int fd, std::string const &s)
+        {
+            size_t off = 0;
+
+            while (off < s.size())
+            {
+                auto n = ::write(fd, s.data() + off, s.size() - off);
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    throw std::runtime_error(std::string("write: ") + strerror(errno));
+                }
+                off += static_cast<size_t>(n);
+            }
+        }
+
+        // the options of a request, over the defaults of the server...
+        //
+
+        context
+        make_context(context const &defaults, std::string const &header, std::string &config_file)
+        {
+            context ctx(defaults);
+
+            ctx.verbose = false;                // the server log is not for the data structures
+
+            std::istringstream in(header);
+            std::string opt;
+
+            auto arg = [&]() -> std::string
+            {
+                std::string a;
+                if (!(in >> a))
+                    throw std::runtime_error(opt + ": argument missing");
+                return a;
+            };
+
+            while (in >> opt)
+            {
+                if (opt == "-c" || opt == "--config")
+                    config_file = arg();
+                else if (opt == "-f" || opt == "--format")
+                    ctx.format = arg();
+                else if (opt == "-k" || opt == "--kernel")
+                    ctx.kernel = arg();
+                else if (opt == "-C" || opt == "--core")
+                    ctx.core = arg();
+                else if (opt == "-O" || opt == "--overlay-dir")
+                    ctx.overlay_dir = arg();
+                else if (opt == "--vhost-dir")
+                    ctx.vhost_dir = arg();
+                else if (opt == "--hugepages")
+                    ctx.hugepages = arg();
+                else if (opt == "--p2p-port")
+                    ctx.p2p_port = std::stoi(arg());
+                else if (opt == "--initrd-cache")
+                    ctx.initrd_cache = arg();
+                else if (opt == "-Q" || opt == "--qmp")
+                    ctx.qmp = arg();
+                else if (opt == "-i" || opt == "--append-ip")
+                    ctx.append_ip = true;
+                else if (opt == "-P" || opt == "--ptnetmap")
+                    ctx.ptnetmap = true;
+                else
+                    throw std::runtime_error("unsupported option " + opt);
+            }
+
+            return ctx;
+        }
+
+        // serve a request: the plan is built into a memfd, then sent
+        // after the reply line (its size is known only at the end)...
+        //
+
+        void
+        serve(int fd, context const &defaults, cache &c)
+        {
+            int plan = -1;
+
+            try
+            {
+                auto req = read_request(fd);
+                auto eol = req.find('\n');
+
+                std::string config_file;
+
+                auto ctx = make_context(defaults, req.substr(0, eol), config_file);
+
+                auto content = config_file.empty() ? (eol == std::string::npos ? std::string() : req.substr(eol + 1))
+                                                   : read_file(config_file);
+                bool hit;
+
+                auto topo = c.get(config_file.empty() ? "inline" : config_file, content, hit);
+
+                plan = ::memfd_create("plan", MFD_CLOEXEC);
+                if (plan < 0)
+                    throw std::runtime_error(std::string("memfd_create: ") + strerror(errno));
+
+                ctx.output = plan;
+
+                if (builder(ctx, topo->switches, topo->nodes, topo->settings) != 0)
+                    throw std::runtime_error("build failed");
+
+                auto size = ::lseek(plan, 0, SEEK_END);
+
+                write_all(fd, more::sprint("ok %1 %2\n", size, hit ? "hit" : "miss"));
+
+                off_t off = 0;
+                while (off < size)
+                {
+                    if (::sendfile(fd, plan, &off, static_cast<size_t>(size - off)) < 0 && errno != EINTR)
+                        throw std::runtime_error(std::string("sendfile: ") + strerror(errno));
+                }
+            }
+            catch(std::exception &e)
+            {
+                std::string msg(e.what());
+                std::replace(std::begin(msg), std::end(msg), '\n', ' ');
+
+                if (defaults.verbose)
+                    std::cerr << "server: " << msg << std::endl;
+
+                try
+                {
+                    write_all(fd, "error " + msg + "\n");
+                }
+                catch(...)
+                {}
+            }
+
+            if (plan >= 0)
+                ::close(plan);
+            ::close(fd);
+        }
+    }
+
+    /////////// public functions...
+
+    int run(context const &ctx, std::string const &path, size_t cache_size)
+    {
+        sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+
+        if (path.size() >= sizeof(sa.sun_path))
+            throw std::runtime_error("server: socket path too long: " + path);
+
+        strcpy(sa.sun_path, path.c_str());
+
+        // a socket left by a previous server is removed, anything else is not...
+        //
+
+        struct stat st;
+        if (::lstat(path.c_str(), &st) == 0)
+        {
+            if (!S_ISSOCK(st.st_mode))
+                throw std::runtime_error("server: " + path + " exists");
+            ::unlink(path.c_str());
+        }
+
+        int s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (s < 0)
+            throw std::runtime_error(std::string("server: socket: ") + strerror(errno));
+
+        if (::bind(s, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0 || ::listen(s, 128) < 0)
+        {
+            auto err = errno;
+            ::close(s);
+            throw std::runtime_error("server: " + path + ": " + strerror(err));
+        }
+
+        // SIGINT and SIGTERM are waited for by this thread (blocked in the
+        // workers, which inherit the mask); a client going away is not
+        // a reason to die...
+        //
+
+        sigset_t set, old;
+        sigemptyset(&set);
+        sigaddset(&set, SIGINT);
+        sigaddset(&set, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &set, &old);
+
+        ::signal(SIGPIPE, SIG_IGN);
+
+        cache c(cache_size);
+
+        std::vector<std::thread> pool;
+
+        for(int n = 0; n < std::max(ctx.jobs, 1); ++n)
+        {
+            pool.emplace_back([&]()
+            {
+                for(;;)
+                {
+                    int fd = ::accept4(s, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (fd < 0)
+                    {
+                        if (errno == EINTR || errno == ECONNABORTED)
+                            continue;
+                        break;
+                    }
+
+                    // a client that never completes its request...
+                    //
+
+                    struct timeval tv = { 10, 0 };
+                    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+                    serve(fd, ctx, c);
+                }
+            });
+        }
+
+        if (ctx.verbose)
+            std::cerr << "server: listening on " << path << " (" << pool.size() << " thread(s))" << std::endl;
+
+        int sig;
+        sigwait(&set, &sig);
+
+        // wake up the workers blocked in accept, let them complete their
+        // request...
+        //
+
+        ::shutdown(s, SHUT_RDWR);
+
+        for(auto & t : pool)
+            t.join();
+
+        ::close(s);
+        ::unlink(path.c_str());
+
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
+        return 0;
+    }
+
+    } // namespace server
+}
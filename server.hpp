@@ -0,0 +1,33 @@
+#pragma once
+
+#include <network.hpp>
+#include <context.hpp>
+
+#include <string>
+
+namespace topo
+{
+    namespace server
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // resident mode (--listen): build plans on request over a unix
+        // socket, with the parsed topologies cached by content hash.
+        //
+        // request: a line of options (-c file, -f, -i, -k, -C, -P, -O, -Q,
+        //          --vhost-dir, --hugepages, --p2p-port, --initrd-cache),
+        //          followed, if there is no -c, by the config itself up
+        //          to the end of the stream (shutdown of the write side).
+        //
+        // reply:   "ok <bytes> <hit|miss>\n" and the plan, or
+        //          "error <message>\n".
+        //
+        // Requests are served by ctx.jobs threads; the options of ctx
+        // are the defaults of the requests.
+        //
+
+        int run(context const &ctx, std::string const &path, size_t cache_size = 16);
+
+    } // namespace server
+
+} // namespace topo
@@ -0,0 +1,245 @@
+#include <stats.hpp>
+
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <print.hpp>
+
+namespace topo
+{
+    namespace stats {
+
+    namespace
+    {
+        int
+        perf_open(uint64_t config, int group)
+        {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = config;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.disabled = group == -1;
+            attr.inherit = 1;                   // no PERF_FORMAT_GROUP read with it
+            attr.exclude_kernel = 1;            // allowed with perf_event_paranoid <= 2
+            attr.exclude_hv = 1;
+
+            // this process on any cpu: the calling thread, and the threads
+            // and processes it creates afterwards (their counts are read
+            // along with its own)...
+            //
+
+            return static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+        }
+
+        std::string
+        escape(std::string const &s)
+        {
+            static const char hex[] = "0123456789abcdef";
+
+            std::string ret;
+
+            for(auto c : s)
+            {
+                if (c == '"' || c == '\\')
+                    ret += '\\';
+
+                if (static_cast<unsigned char>(c) < 0x20)
+                    ret += std::string("\\u00") + hex[(c >> 4) & 0xf] + hex[c & 0xf];
+                else
+                    ret += c;
+            }
+
+            return ret;
+        }
+
+        uint64_t
+        per_second(uint64_t n, std::chrono::microseconds wall)
+        {
+            return wall.count() > 0 ? n * 1000000 / static_cast<uint64_t>(wall.count()) : 0;
+        }
+    }
+
+    /////////// public functions...
+
+    recorder::recorder(std::string const &config)
+    : config_(config)
+    , start_(clock_type::now())
+    , fd_{ -1, -1, -1 }
+    , perf_("ok")
+    , phases_()
+    , counts_()
+    , begin_()
+    , has_begin_(false)
+    , sample_()
+    {
+        static const uint64_t config_id[3] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+
+        for(int i = 0; i < 3; ++i)
+        {
+            fd_[i] = perf_open(config_id[i], fd_[0]);
+            if (fd_[i] < 0)
+            {
+                perf_ = std::string("unavailable: ") + strerror(errno);
+
+                for(int j = 0; j < i; ++j)
+                    ::close(fd_[j]);
+
+                fd_[0] = fd_[1] = fd_[2] = -1;
+                return;
+            }
+        }
+
+        ::ioctl(fd_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+
+    recorder::~recorder()
+    {
+        for(auto fd : fd_)
+            if (fd >= 0)
+                ::close(fd);
+    }
+
+
+    bool
+    recorder::read(sample &s) const
+    {
+        if (fd_[0] < 0)
+            return false;
+
+        uint64_t v[3];
+
+        for(int i = 0; i < 3; ++i)
+        {
+            uint64_t buf[3];                    // value, time enabled, time running
+
+            if (::read(fd_[i], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf)))
+                return false;
+
+            // the counter has been multiplexed with other events: scale...
+            //
+
+            v[i] = buf[2] != 0 && buf[2] < buf[1] ? static_cast<uint64_t>(static_cast<double>(buf[0]) * buf[1] / buf[2]) : buf[0];
+        }
+
+        s.cycles       = v[0];
+        s.instructions = v[1];
+        s.cache_misses = v[2];
+        return true;
+    }
+
+
+    void
+    recorder::begin(std::string const &name)
+    {
+        if (has_begin_)
+            end();
+
+        phases_.push_back(phase{name, std::chrono::microseconds(0), false, sample()});
+
+        has_begin_ = true;
+        begin_ = clock_type::now();
+        phases_.back().has_counters = read(sample_);
+    }
+
+
+    void
+    recorder::end()
+    {
+        if (!has_begin_)
+            return;
+
+        auto now = clock_type::now();
+
+        auto & p = phases_.back();
+        sample s;
+
+        if (p.has_counters && read(s))
+        {
+            p.counters.cycles       = s.cycles - sample_.cycles;
+            p.counters.instructions = s.instructions - sample_.instructions;
+            p.counters.cache_misses = s.cache_misses - sample_.cache_misses;
+        }
+        else
+            p.has_counters = false;
+
+        p.wall = std::chrono::duration_cast<std::chrono::microseconds>(now - begin_);
+        has_begin_ = false;
+    }
+
+
+    void
+    recorder::count(std::string const &item, size_t n)
+    {
+        for(auto & c : counts_)
+        {
+            if (c.first == item)
+            {
+                c.second += n;
+                return;
+            }
+        }
+
+        counts_.emplace_back(item, n);
+    }
+
+
+    std::string
+    recorder::json() const
+    {
+        auto wall = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start_);
+
+        static const more::format head("{\"config\":\"%1\",\"wall_us\":%2,\"phases\":[");
+        static const more::format phase_wall("{\"name\":\"%1\",\"wall_us\":%2");
+        static const more::format phase_perf(",\"cycles\":%1,\"instructions\":%2,\"cache_misses\":%3");
+        static const more::format item("\"%1\":%2");
+
+        std::string ret;
+
+        head.append(ret, escape(config_), wall.count());
+
+        for(size_t i = 0; i < phases_.size(); ++i)
+        {
+            auto & p = phases_[i];
+
+            if (i)
+                ret += ',';
+
+            phase_wall.append(ret, escape(p.name), p.wall.count());
+            if (p.has_counters)
+                phase_perf.append(ret, p.counters.cycles, p.counters.instructions, p.counters.cache_misses);
+            ret += '}';
+        }
+
+        ret += "],\"counts\":{";
+
+        for(size_t i = 0; i < counts_.size(); ++i)
+        {
+            if (i)
+                ret += ',';
+            item.append(ret, escape(counts_[i].first), counts_[i].second);
+        }
+
+        ret += "},\"throughput\":{";
+
+        for(size_t i = 0; i < counts_.size(); ++i)
+        {
+            if (i)
+                ret += ',';
+            item.append(ret, escape(counts_[i].first) + "_per_s", per_second(counts_[i].second, wall));
+        }
+
+        return ret + "},\"perf\":\"" + escape(perf_) + "\"}\n";
+    }
+
+    } // namespace stats
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace topo
+{
+    namespace stats
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // --stats: wall time of each phase of a build, item counts and
+        // throughput, printed as a single JSON object. Cycles, instructions
+        // and cache misses of each phase are read from a perf_event_open
+        // group inherited by the threads and commands the process creates
+        // (a command is counted once it has exited), when perf is
+        // available.
+        //
+
+        typedef std::chrono::steady_clock clock_type;
+
+        struct sample
+        {
+            uint64_t cycles;
+            uint64_t instructions;
+            uint64_t cache_misses;
+        };
+
+        struct phase
+        {
+            std::string name;
+            std::chrono::microseconds wall;
+            bool has_counters;
+            sample counters;
+        };
+
+        class recorder
+        {
+        public:
+            explicit recorder(std::string const &config);
+            ~recorder();
+
+            recorder(recorder const &) = delete;
+            recorder& operator=(recorder const &) = delete;
+
+            // begin a phase (ending the current one, if any)...
+            //
+
+            void begin(std::string const &name);
+
+            void end();
+
+            void count(std::string const &item, size_t n);
+
+            // {"config":...,"wall_us":...,"phases":[...],"counts":{...},
+            //  "throughput":{...},"perf":"ok" or the reason it is not}
+            //
+
+            std::string json() const;
+
+        private:
+            bool read(sample &s) const;
+
+            std::string config_;
+            clock_type::time_point start_;
+
+            int fd_[3];                         // cycles (group leader), instructions, cache misses
+            std::string perf_;
+
+            std::vector<phase> phases_;
+            std::vector<std::pair<std::string, size_t>> counts_;
+
+            clock_type::time_point begin_;
+            bool has_begin_;
+            sample sample_;
+        };
+
+        // phases as a scope (the last one ends with it); a null recorder
+        // (no --stats) records nothing...
+        //
+
+        class scope
+        {
+        public:
+            scope(recorder *r, std::string const &name)
+            : r_(r)
+            {
+                if (r_)
+                    r_->begin(name);
+            }
+
+            // end the current phase, begin the next one...
+            //
+
+            void next(std::string const &name)
+            {
+                if (r_)
+                    r_->begin(name);
+            }
+
+            void count(std::string const &item, size_t n)
+            {
+                if (r_)
+                    r_->count(item, n);
+            }
+
+            ~scope()
+            {
+                if (r_)
+                    r_->end();
+            }
+
+            scope(scope const &) = delete;
+            scope& operator=(scope const &) = delete;
+
+        private:
+            recorder *r_;
+        };
+
+    } // namespace stats
+
+} // namespace topo
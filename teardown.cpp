@@ -0,0 +1,360 @@
+#include <teardown.hpp>
+#include <script.hpp>
+#include <netlink.hpp>
+#include <emitter.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <print.hpp>
+
+namespace topo
+{
+    namespace teardown {
+
+    namespace
+    {
+        // a regex matching the device of a VM in a command line, but not in
+        // the one of pkill/pgrep: "[t]ap1([^0-9]|$)"
+        //
+
+        std::string
+        make_pattern(std::string const &dev)
+        {
+            return "[" + dev.substr(0, 1) + "]" + dev.substr(1) + "([^0-9]|$)";
+        }
+
+        // a pattern of a state file: one given by make_pattern for a device
+        // name that needs no quoting (it is spliced into the stop command)...
+        //
+
+        bool
+        is_pattern(std::string const &p)
+        {
+            static const std::string tail("([^0-9]|$)");
+
+            if (p.size() < 3 + tail.size() || p[0] != '[' || p[2] != ']')
+                return false;
+
+            auto dev = p.substr(1, 1) + p.substr(3, p.size() - 3 - tail.size());
+
+            return script::shell_quote(dev) == dev && make_pattern(dev) == p;
+        }
+
+        // stop a batch of VMs, selected by one regex anchored to the command
+        // line of startmv.sh and qemu (a tcpdump -i tap1 is not a VM) and,
+        // when known, by their process groups as well (pkill ANDs them: a
+        // stale pgid of an unrelated process is never signalled)...
+        //
+
+        script::line
+        make_stop_cmdline(std::string const &sel, int timeout)
+        {
+            static const more::format stop("pkill -TERM %1 || exit 0; "
+                                           "for i in $(seq 1 %2); do sleep 0.1; pgrep %1 >/dev/null || exit 0; done; "
+                                           "pkill -KILL %1; exit 0");
+
+            return script::shell_cmd(stop(sel, std::max(timeout, 0) * 10));
+        }
+
+        std::vector<script::line>
+        make_stop_cmdlines(std::vector<vm> const &vms, int timeout, size_t batch)
+        {
+            std::vector<vm const *> grouped, other;
+
+            for(auto & v : vms)
+                (v.pgid > 0 ? grouped : other).push_back(&v);
+
+            std::vector<script::line> ret;
+
+            for(auto list : { &grouped, &other })
+            {
+                for(size_t i = 0; i < list->size(); i += batch)
+                {
+                    std::string groups, patterns;
+
+                    for(size_t j = i; j < std::min(i + batch, list->size()); ++j)
+                    {
+                        auto & v = *(*list)[j];
+                        if (v.pgid > 0)
+                            groups += (groups.empty() ? "" : ",") + std::to_string(v.pgid);
+                        patterns += (patterns.empty() ? "" : "|") + v.pattern;
+                    }
+
+                    ret.push_back(make_stop_cmdline(more::sprint("%1-f \"^(sh [^ ]*startmv\\.sh|[^ ]*qemu[^ ]*) .*(%2)\"",
+                                                                 groups.empty() ? "" : "-g " + groups + " ", patterns),
+                                                    timeout));
+                }
+            }
+
+            return ret;
+        }
+
+        // ip -batch: a missing device (partial deployment) is not an error...
+        //
+
+        std::vector<script::line>
+        make_del_cmdlines(std::vector<std::string> const &names, size_t batch)
+        {
+            std::vector<script::line> ret;
+
+            for(size_t i = 0; i < names.size(); i += batch)
+            {
+                std::string devs;
+                for(size_t j = i; j < std::min(i + batch, names.size()); ++j)
+                    devs += ' ' + script::shell_quote(names[j]);
+
+                ret.push_back(script::shell_cmd(more::sprint("printf \"link del %%s\\n\"%1 | ip -force -batch - 2>/dev/null; exit 0", devs)));
+            }
+
+            return ret;
+        }
+
+        std::vector<script::line>
+        make_rm_cmdlines(std::vector<std::string> const &files, size_t batch)
+        {
+            std::vector<script::line> ret;
+
+            for(size_t i = 0; i < files.size(); i += batch)
+            {
+                std::string paths;
+                for(size_t j = i; j < std::min(i + batch, files.size()); ++j)
+                    paths += ' ' + script::shell_quote(files[j]);
+
+                ret.push_back(script::shell_cmd("rm -f" + paths));
+            }
+
+            return ret;
+        }
+
+        std::vector<script::line>
+        make_vale_cmdlines(std::vector<std::pair<std::string, std::string>> const &vale, size_t batch)
+        {
+            static const more::format vale_port("vale-ctl -d %1; vale-ctl -r %2; ");
+
+            std::vector<script::line> ret;
+
+            for(size_t i = 0; i < vale.size(); i += batch)
+            {
+                std::string cmds;
+                for(size_t j = i; j < std::min(i + batch, vale.size()); ++j)
+                    vale_port.append(cmds, script::shell_quote(vale[j].first + ":" + vale[j].second), script::shell_quote(vale[j].second));
+
+                ret.push_back(script::shell_cmd(cmds + "exit 0"));
+            }
+
+            return ret;
+        }
+    }
+
+    /////////// public functions...
+
+    State make_state(context const &ctx, SwitchMap const &sm, Nodes const &ns, TapMap const &tm)
+    {
+        State s;
+
+        // switches: taps are numbered as in script::make_bridges...
+        //
+
+        int next = 1;
+        for(auto & sw : sm)
+        {
+            auto nlink = get_num_links(sw.second);
+            auto type  = node_type(get_switch(sw.second));
+
+            if (type == switch_type::vale)
+            {
+                for(int t = next; t < next + nlink; ++t)
+                    s.vale.emplace_back(script::vale_switch_name(sw.first), script::vale_port_name(t));
+            }
+            else if (type == switch_type::p2p)
+            {
+                // nothing on the host...
+            }
+            else if (type == switch_type::vhostuser)
+            {
+                for(int t = next; t < next + nlink; ++t)
+                    s.files.push_back(script::vhost_socket(ctx, t));
+
+                s.files.push_back(script::vhost_port_map(ctx, sw.first));
+            }
+            else
+            {
+                for(int t = next; t < next + nlink; ++t)
+                    s.taps.push_back("tap" + std::to_string(t));
+
+                // macvtap switches are named after an existing device...
+                //
+
+                if (type == switch_type::bridge)
+                    s.bridges.push_back(sw.first);
+            }
+
+            next += nlink;
+        }
+
+        // VMs are recognized by their first NIC...
+        //
+
+        for(auto & n : ns)
+        {
+            auto t = tm.find(node_name(n));
+            if (t == std::end(tm))
+                throw std::logic_error("teardown::make_state: internal error");
+
+            if (t->second.empty())
+                continue;
+
+            auto it = sm.find(port_linkname(node_ports(n).front()));
+            if (it == std::end(sm))
+                throw std::logic_error("teardown::make_state: internal error");
+
+            auto type = node_type(get_switch(it->second));
+            auto dev  = type == switch_type::vale      ? script::vale_port_name(t->second.front()) :
+                        type == switch_type::vhostuser ? script::vhost_port_name(t->second.front()) :
+                        type == switch_type::p2p       ? "localaddr=127.0.0.1:" + std::to_string(ctx.p2p_port + t->second.front())
+                                                       : "tap" + std::to_string(t->second.front());
+
+            s.vms.push_back(vm{node_name(n), make_pattern(dev), 0});
+        }
+
+        return s;
+    }
+
+
+    void save(std::string const &path, State const &s)
+    {
+        std::ofstream out(path);
+        if (!out)
+            throw std::runtime_error("teardown: cannot write " + path);
+
+        for(auto & v : s.vms)
+        {
+            out << "vm " << v.name << ' ' << v.pattern;
+            if (v.pgid > 0)
+                out << ' ' << v.pgid;
+            out << '\n';
+        }
+        for(auto & t : s.taps)
+            out << "tap " << t << '\n';
+        for(auto & b : s.bridges)
+            out << "bridge " << b << '\n';
+        for(auto & v : s.vale)
+            out << "vale " << v.first << ' ' << v.second << '\n';
+        for(auto & f : s.files)
+            out << "file " << f << '\n';
+
+        if (!out.flush())
+            throw std::runtime_error("teardown: cannot write " + path);
+    }
+
+
+    State load(std::string const &path)
+    {
+        std::ifstream in(path);
+        if (!in)
+            throw std::runtime_error("teardown: cannot read " + path);
+
+        State s;
+        std::string l;
+        int n = 0;
+
+        while (std::getline(in, l))
+        {
+            n++;
+
+            std::istringstream ss(l);
+            std::string kind, a, b, c;
+
+            if (!(ss >> kind))
+                continue;
+
+            ss >> a >> b >> c;
+
+            char *end;
+            auto pgid = std::strtol(c.c_str(), &end, 10);
+
+            if (kind == "vm" && is_pattern(b) && *end == '\0' && pgid >= 0)
+                s.vms.push_back(vm{a, b, static_cast<pid_t>(pgid)});
+            else if (kind == "tap" && !a.empty())
+                s.taps.push_back(a);
+            else if (kind == "bridge" && !a.empty())
+                s.bridges.push_back(a);
+            else if (kind == "vale" && !b.empty())
+                s.vale.emplace_back(a, b);
+            else if (kind == "file" && !a.empty())
+                s.files.push_back(a);
+            else
+                throw std::runtime_error(more::sprint("teardown: %1:%2: parse error", path, n));
+        }
+
+        return s;
+    }
+
+
+    exec::Plan make_plan(State const &s, int stop_timeout, size_t batch)
+    {
+        exec::Plan plan;
+
+        auto vms = make_stop_cmdlines(s.vms, stop_timeout, batch);
+
+        auto bridges = make_del_cmdlines(s.bridges, batch);
+        auto vale = make_vale_cmdlines(s.vale, batch);
+        auto files = make_rm_cmdlines(s.files, batch);
+
+        bridges.insert(bridges.end(), vale.begin(), vale.end());
+        bridges.insert(bridges.end(), files.begin(), files.end());
+
+        plan.emplace_back("vms",     std::move(vms));
+        plan.emplace_back("taps",    make_del_cmdlines(s.taps, batch));
+        plan.emplace_back("bridges", std::move(bridges));
+
+        return plan;
+    }
+
+
+    int run(State const &s, context const &ctx)
+    {
+        auto plan = make_plan(s, ctx.stop_timeout);
+
+        if (!ctx.execute)
+        {
+            auto out = emit::make_emitter(ctx.format, ctx.output);
+
+            out->section("vms", "stop VMs...");         out->commands(plan[0].second);
+            out->section("taps", "delete taps...");     out->commands(plan[1].second);
+            out->section("bridges", "delete bridges..."); out->commands(plan[2].second);
+
+            out->flush();
+            return 0;
+        }
+
+        // native backend: the VMs are stopped by the plan, taps and
+        // bridges deleted through rtnetlink (VALE ports still by vale-ctl)...
+        //
+
+        if (ctx.netlink)
+        {
+            plan.resize(1);
+
+            if (exec::run(plan, ctx))
+                return 1;
+
+            size_t err = netlink::remove_links(s.taps) +
+                         netlink::remove_links(s.bridges);
+
+            plan[0] = exec::Phase("bridges", make_vale_cmdlines(s.vale, 256));
+
+            auto files = make_rm_cmdlines(s.files, 256);
+            plan[0].second.insert(plan[0].second.end(), files.begin(), files.end());
+
+            return (exec::run(plan, ctx) || err) ? 1 : 0;
+        }
+
+        return exec::run(plan, ctx);
+    }
+
+    } // namespace teardown
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <network.hpp>
+#include <exec.hpp>
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace topo
+{
+    namespace teardown
+    {
+        ///////////////////////////////////////////////////////////////////////
+        //
+        // what a deployment has created, in the order it must be removed:
+        //
+        //  vms     VM name, a pattern matching its processes (pkill -f) and
+        //          the process group it was launched in (0: unknown)
+        //  taps    tap interfaces
+        //  bridges bridges
+        //  vale    VALE switch and persistent port
+        //  files   files left behind (vhost-user sockets and port maps)
+        //
+        // It is either computed from the config or loaded from the state
+        // file saved at bring-up.
+        //
+
+        struct vm
+        {
+            std::string name;
+            std::string pattern;
+            pid_t pgid;
+        };
+
+        struct State
+        {
+            std::vector<vm> vms;
+            std::vector<std::string> taps;
+            std::vector<std::string> bridges;
+            std::vector<std::pair<std::string, std::string>> vale;
+            std::vector<std::string> files;
+        };
+
+        State make_state(context const &ctx, SwitchMap const &sm, Nodes const &ns, TapMap const &tm);
+
+        // state file: one entry per line, "vm <name> <pattern> [<pgid>]",
+        // "tap <name>", "bridge <name>", "vale <switch> <port>" or
+        // "file <path>"
+        //
+
+        void save(std::string const &path, State const &s);
+
+        State load(std::string const &path);
+
+        // the reverse plan: stop the VMs (SIGTERM, SIGKILL after
+        // stop_timeout seconds), then delete the taps, the bridges and the
+        // files, 'batch' devices (or VMs) per command. The VMs of a batch
+        // are signalled at once, by process group when known, otherwise by
+        // pattern, and waited for together...
+        //
+
+        exec::Plan make_plan(State const &s, int stop_timeout, size_t batch = 256);
+
+        // run (--execute) or emit the plan; with --netlink taps and bridges
+        // are deleted through rtnetlink...
+        //
+
+        int run(State const &s, context const &ctx);
+
+    } // namespace teardown
+
+} // namespace topo
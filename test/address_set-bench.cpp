@@ -0,0 +1,221 @@
+//
+// net::address_set/address_map: same contents as std::unordered_set/map
+// under random inserts and erases, then insert, hit and miss lookups of
+// sequential /24 and /30 allocations (the way subnets are handed out)
+// with std::unordered_set and the former hash, std::unordered_set and
+// net::address_hash, net::address_set (and a flat table with the former
+// hash, where the subnets collide).
+//
+// g++ -std=c++0x -O3 -I lib test/address_set-bench.cpp -o address_set-bench
+//
+
+#include <address_set.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+    int failed = 0;
+
+    // the former std::hash<net::address> (masked s_addr, network order)...
+    //
+
+    struct old_hash
+    {
+        size_t
+        operator()(const net::address& value) const
+        {
+            return value.addr().s_addr & net::address::prefix2mask(value.prefix()).s_addr;
+        }
+    };
+
+    void
+    check(bool ok, std::string const &what)
+    {
+        if (!ok) {
+            std::cerr << "FAIL: " << what << std::endl;
+            failed++;
+        }
+    }
+
+    // first n subnets of the given prefix from 10.0.0.0, in order...
+    //
+
+    std::vector<net::address>
+    allocate(size_t n, size_t prefix)
+    {
+        std::vector<net::address> ret;
+        ret.reserve(n);
+
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            in_addr a;
+            a.s_addr = htonl(0x0a000000 + (i << (32 - prefix)));
+            ret.push_back(net::address(a, prefix));
+        }
+
+        return ret;
+    }
+
+    typedef std::chrono::steady_clock clock_type;
+
+    double
+    ns_per(clock_type::time_point start, size_t n)
+    {
+        return std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / n;
+    }
+
+    template <typename Set>
+    void
+    bench(std::string const &name, std::vector<net::address> const &in, std::vector<net::address> const &shuffled,
+          std::vector<net::address> const &out)
+    {
+        Set s;
+        size_t found = 0;
+
+        auto t = clock_type::now();
+        for(auto & a : in)
+            s.insert(a);
+        auto insert = ns_per(t, in.size());
+
+        t = clock_type::now();
+        for(auto & a : in)
+            found += s.count(a);
+        auto hit = ns_per(t, in.size());
+
+        t = clock_type::now();
+        for(auto & a : shuffled)
+            found += s.count(a);
+        auto hit_shuffled = ns_per(t, shuffled.size());
+
+        t = clock_type::now();
+        for(auto & a : out)
+            found += s.count(a);
+        auto miss = ns_per(t, out.size());
+
+        check(found == in.size() + shuffled.size(), name + ": lookups");
+
+        std::cout << "  " << name << "insert " << insert << ", hit " << hit << ", hit (shuffled) " << hit_shuffled
+                  << ", miss " << miss << " ns" << std::endl;
+    }
+
+    template <typename Set>
+    void
+    bench_hash(std::string const &name, std::vector<net::address> const &in, std::vector<net::address> const &shuffled,
+               std::vector<net::address> const &out)
+    {
+        bench<Set>(name, in, shuffled, out);
+
+        // the longest chain of the std container...
+        //
+
+        Set s(in.begin(), in.end());
+        size_t max = 0;
+        for(size_t b = 0; b < s.bucket_count(); ++b)
+            max = std::max(max, s.bucket_size(b));
+
+        std::cout << "    (" << s.bucket_count() << " buckets, longest " << max << ")" << std::endl;
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    // same contents as the std containers...
+    //
+
+    {
+        net::address_set s;
+        net::address_map<int> m;
+        std::unordered_set<net::address, net::address_hash> ref;
+        std::map<net::address, int> ref_m;
+
+        uint32_t x = 2463534242u;
+
+        for(int i = 0; i < 200000; ++i)
+        {
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+
+            in_addr a;
+            a.s_addr = htonl(0x0a000000 + (x & 0x3ff) * 4);
+            net::address addr(a, x & 0x10000 ? 30 : 24);
+
+            if (x & 0x300000)
+            {
+                check(s.insert(addr).second == ref.insert(addr).second, "insert");
+                m[addr] += i;
+                ref_m[addr] += i;
+            }
+            else
+            {
+                check(s.erase(addr) == ref.erase(addr), "erase");
+                check(m.erase(addr) == ref_m.erase(addr), "map erase");
+            }
+        }
+
+        check(s.size() == ref.size() && m.size() == ref_m.size(), "size");
+
+        size_t n_it = 0;
+        for(auto & a : s)
+            n_it += ref.count(a);
+        check(n_it == ref.size(), "iteration");
+
+        for(auto & p : ref_m)
+            check(m.at(p.first) == p.second, "map value");
+
+        s.clear();
+        check(s.empty() && s.begin() == s.end() && !s.contains(ref_m.begin()->first), "clear");
+    }
+
+    // benchmark...
+    //
+
+    for(size_t prefix : { 24, 30 })
+    {
+        auto as = allocate(2 * n, prefix);
+
+        std::vector<net::address> in(as.begin(), as.begin() + n), out(as.begin() + n, as.end());
+        std::vector<net::address> shuffled(in);
+
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+
+        std::cout << n << " sequential /" << prefix << std::endl;
+
+        bench_hash<std::unordered_set<net::address, old_hash>>("unordered_set, former hash : ", in, shuffled, out);
+        bench_hash<std::unordered_set<net::address, net::address_hash>>("unordered_set, address_hash: ", in, shuffled, out);
+        bench<net::address_set>("address_set                : ", in, shuffled, out);
+    }
+
+    // the former hash in a power of two table: the low bits of a /24 in
+    // network order are the first two octets, all the subnets collide...
+    //
+
+    {
+        size_t m = std::min<size_t>(n, 20000);
+
+        auto as = allocate(2 * m, 24);
+
+        std::vector<net::address> in(as.begin(), as.begin() + m), out(as.begin() + m, as.end());
+
+        std::cout << m << " sequential /24, flat table" << std::endl;
+
+        bench<net::detail::flat_table<net::address, old_hash>>("address_set, former hash   : ", in, in, out);
+        bench<net::address_set>("address_set                : ", in, in, out);
+    }
+
+    if (failed)
+        return 1;
+
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -0,0 +1,187 @@
+//
+// admission::controller against a fake proc directory, on a virtual
+// clock: the files are parsed, the rate grows while the host is calm, is
+// cut to the minimum under CPU pressure or too many runnable threads,
+// launches stop below the memory floor (until the hold timeout) and
+// the controller still works without PSI.
+//
+// usage: admission-check dir   (see admission-test.sh)
+//
+
+#include <admission.hpp>
+
+#include <sys/stat.h>
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace topo;
+
+namespace
+{
+    int failed = 0;
+
+    void
+    check(bool ok, std::string const &what)
+    {
+        if (!ok) {
+            std::cerr << "FAIL: " << what << std::endl;
+            failed++;
+        }
+    }
+
+    void
+    write(std::string const &path, std::string const &content)
+    {
+        std::ofstream out(path);
+        out << content;
+    }
+
+    void
+    write_pressure(std::string const &proc, std::string const &name, double avg10, uint64_t total)
+    {
+        write(proc + "/pressure/" + name,
+              "some avg10=" + std::to_string(avg10) + " avg60=0.00 avg300=0.00 total=" + std::to_string(total) + "\n"
+              "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+    }
+
+    void
+    host(std::string const &proc, unsigned int runnable, uint64_t available, uint64_t cpu_total = 0)
+    {
+        write(proc + "/loadavg", "1.50 1.00 0.50 " + std::to_string(runnable) + "/300 4242\n");
+        write(proc + "/meminfo", "MemTotal:       1000000 kB\n"
+                                 "MemFree:         100000 kB\n"
+                                 "MemAvailable:    " + std::to_string(available) + " kB\n");
+        write_pressure(proc, "cpu", 0, cpu_total);
+        write_pressure(proc, "io", 0, 0);
+        write_pressure(proc, "memory", 0, 0);
+    }
+
+    // launches admitted in 'secs' of virtual time from t; cpu_stall is the
+    // % of time stalled written to pressure/cpu as time goes by...
+    //
+
+    size_t
+    run(admission::controller &c, std::string const &proc, admission::clock_type::time_point &t, double secs,
+        unsigned int runnable, uint64_t available, double cpu_stall = 0)
+    {
+        auto end = t + std::chrono::duration_cast<admission::clock_type::duration>(std::chrono::duration<double>(secs));
+        size_t n = 0;
+
+        while (t < end)
+        {
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+            host(proc, runnable, available, static_cast<uint64_t>(us * cpu_stall / 100));
+
+            auto d = c.admit(t);
+            if (d == admission::clock_type::duration::zero())
+                n++;
+            else
+                t += d;
+        }
+
+        return n;
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+        return 2;
+
+    std::string proc(argv[1]);
+    mkdir((proc + "/pressure").c_str(), 0755);
+
+    write(proc + "/stat", "cpu  1 2 3 4\ncpu0 1 2 3 4\ncpu1 1 2 3 4\ncpu2 1 2 3 4\ncpu3 1 2 3 4\nintr 0\n");
+
+    // parsing...
+    //
+
+    host(proc, 3, 500000, 123456);
+
+    auto s = admission::read(proc);
+
+    check(std::fabs(s.load1 - 1.5) < 1e-9 && s.runnable == 3 && s.ncpu == 4, "loadavg, stat");
+    check(s.has_pressure && s.cpu.total == 123456 && s.io.total == 0, "pressure");
+    check(s.mem_total == 1000000 && s.mem_available == 500000, "meminfo");
+
+    admission::limits l;
+    admission::clock_type::time_point t(std::chrono::seconds(1000));
+
+    // calm host: the rate grows up to max_rate...
+    //
+
+    {
+        admission::controller c(proc, l);
+
+        auto n = run(c, proc, t, 2, 2, 500000);
+        check(n > l.initial_rate * 2 && !c.congested(), "calm: rate grows");
+
+        run(c, proc, t, 20, 2, 500000);
+        check(c.rate() == l.max_rate, "calm: max rate");
+    }
+
+    // CPU stalled half of the time: down to min_rate...
+    //
+
+    {
+        admission::controller c(proc, l);
+
+        run(c, proc, t, 1, 2, 500000);
+        auto n = run(c, proc, t, 10, 2, 500000, 50);
+
+        check(c.congested() && c.rate() == l.min_rate, "cpu pressure: min rate");
+        check(n <= l.burst + 10 * l.initial_rate, "cpu pressure: launches throttled");
+
+        run(c, proc, t, 2, 2, 500000);
+        check(!c.congested() && c.rate() > l.min_rate, "cpu pressure: recovery");
+    }
+
+    // too many runnable threads for 4 cpus...
+    //
+
+    {
+        admission::controller c(proc, l);
+
+        run(c, proc, t, 5, 40, 500000);
+        check(c.congested() && c.rate() == l.min_rate, "runnable: min rate");
+    }
+
+    // below the memory floor: nothing for hold_timeout...
+    //
+
+    {
+        admission::controller c(proc, l);
+
+        auto n = run(c, proc, t, 10, 2, 20000);
+        check(n == 0, "memory floor: no launch");
+
+        n = run(c, proc, t, 30, 2, 20000);
+        check(n > 0 && c.held() >= l.hold_timeout - l.interval, "memory floor: hold timeout");
+    }
+
+    // no PSI on this kernel...
+    //
+
+    {
+        host(proc, 2, 500000);
+        remove((proc + "/pressure/cpu").c_str());
+
+        admission::controller c(proc, l);
+
+        auto s = admission::read(proc);
+        check(!s.has_pressure, "no PSI");
+
+        admission::clock_type::time_point t0(std::chrono::seconds(5000));
+        check(c.admit(t0) == admission::clock_type::duration::zero(), "no PSI: admitted");
+    }
+
+    if (failed)
+        return 1;
+
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# --admission: the controller against a fake proc directory (see
+# test/admission-check.cpp), then the example topology run with
+# --execute --admission against the stub scripts in test/stub, with a
+# fake calm host and with no proc files at all. A launch that fails while
+# the next one waits for admission stops the phase: it is collected
+# during the wait.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+${CXX:-g++} -std=c++0x -O2 -I"$TOP" -I"$TOP"/lib -o "$TMP"/admission-check \
+    "$TOP"/test/admission-check.cpp "$TOP"/admission.cpp || { echo "FAIL: build admission-check"; exit 1; }
+
+mkdir "$TMP"/proc
+"$TMP"/admission-check "$TMP"/proc > /dev/null || { echo "FAIL: admission-check"; exit 1; }
+
+mkdir "$TMP"/run
+cp "$TOP"/test/stub/*.sh "$TMP"/run && cd "$TMP"/run || exit 1
+
+echo "0.10 0.10 0.10 1/100 1" > "$TMP"/proc/loadavg
+printf "MemTotal: 1000000 kB\nMemAvailable: 900000 kB\n" > "$TMP"/proc/meminfo
+for p in cpu io memory; do
+    echo "some avg10=0.00 avg60=0.00 avg300=0.00 total=0" > "$TMP"/proc/pressure/$p
+done
+
+"$TOP"/topo-builder -c "$TOP"/example/simple.conf -x -j 4 --admission --proc "$TMP"/proc 2> "$TMP"/err ||
+    { cat "$TMP"/err; echo "FAIL: execute"; exit 1; }
+grep -q "exec: admission: 2 launches" "$TMP"/err || { cat "$TMP"/err; echo "FAIL: launches not admitted"; exit 1; }
+
+"$TOP"/topo-builder -c "$TOP"/example/simple.conf -x -d --admission --proc "$TMP"/none 2> "$TMP"/err ||
+    { cat "$TMP"/err; echo "FAIL: execute (dag, no proc)"; exit 1; }
+grep -q "exec: admission: 2 launches" "$TMP"/err || { cat "$TMP"/err; echo "FAIL: dag launches not admitted"; exit 1; }
+
+STUB_EXIT=1 "$TOP"/topo-builder -c "$TOP"/example/simple.conf -x -j 4 --admission --proc "$TMP"/proc 2> "$TMP"/err &&
+    { cat "$TMP"/err; echo "FAIL: failed launch not reported"; exit 1; }
+grep -q "exec: admission: 1 launches" "$TMP"/err || { cat "$TMP"/err; echo "FAIL: launch admitted after a failure"; exit 1; }
+
+"$TOP"/topo-builder -c "$TOP"/example/simple.conf --admission 2>/dev/null && { echo "FAIL: --admission without --execute"; exit 1; }
+
+echo "PASS"
@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# build all the examples at once in batch mode, in every output format:
+# each output must be identical to the one of a single build of the
+# same config; a broken config fails alone. The JSON commands are the
+# ones of the script.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+for fmt in sh json bin; do
+    mkdir -p "$TMP/$fmt"
+    "$TOP"/topo-builder -b "$TMP/$fmt" -f $fmt -j 4 -i "$TOP"/example/*.conf 2>/dev/null || { echo "FAIL: batch $fmt"; exit 1; }
+    for conf in "$TOP"/example/*.conf; do
+        name=$(basename "$conf" .conf)
+        "$TOP"/topo-builder -c "$conf" -f $fmt -i 2>/dev/null > "$TMP/single" || { echo "FAIL: build $name"; exit 1; }
+        cmp -s "$TMP/single" "$TMP/$fmt/$name.$fmt" || { echo "FAIL: $name.$fmt differs"; exit 1; }
+    done
+done
+
+grep "^sh " "$TMP/sh/simple.sh" > "$TMP/sh.cmds"
+sed 's/.*"cmd":"\(.*\)"}$/\1/; s/\\"/"/g' "$TMP/json/simple.json" > "$TMP/json.cmds"
+cmp -s "$TMP/sh.cmds" "$TMP/json.cmds" || { echo "FAIL: JSON commands differ from the script"; exit 1; }
+
+printf "[nodes]\nbroken\n" > "$TMP/broken.conf"
+mkdir -p "$TMP/err"
+"$TOP"/topo-builder -b "$TMP/err" "$TMP/broken.conf" "$TOP"/example/simple.conf 2>/dev/null && { echo "FAIL: error not reported"; exit 1; }
+[ -s "$TMP/err/simple.sh" ] || { echo "FAIL: good config not built"; exit 1; }
+
+echo "PASS"
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# dependency graph of a large topology (one VM per node, two ports each):
+# -g must give one vertex per command and one edge per dependency, and a
+# dry run of --dag must schedule every command, with 1 and 8 jobs. Names
+# are escaped in the dot labels. Prints the time of each step.
+#
+# usage: dag-test.sh [N]   (default 100000)
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+N=${1:-100000}
+S=$(( (N + 199) / 200 ))
+
+{
+    echo "switches = ["
+    i=0
+    while [ $i -lt $S ]; do
+        echo "( lan$i bridge ) ( wan$i bridge )"
+        i=$((i + 1))
+    done
+    echo "]"
+    echo "nodes = ["
+    echo "( a[0..$((N - 1))] image \"a{i%4}.img\" tty {i+1} [ 10.{i/65536}.{i/256%256}.{i%256}/8 -> lan{i/200} 11.{i/65536}.{i/256%256}.{i%256}/8 -> wan{i/200} ] )"
+    echo "]"
+} > "$TMP"/big.conf
+
+now() { date +%s%N; }
+
+t=$(now)
+"$TOP"/topo-builder -c "$TMP"/big.conf -g > "$TMP"/g.dot 2>/dev/null || { echo "FAIL: graph"; exit 1; }
+printf "%d nodes: graph %d ms\n" $N $(( ($(now) - t) / 1000000 ))
+
+# 2S bridges, kvm, N VMs; each VM depends on kvm and its 2 bridges...
+
+[ $(grep -c "label=" "$TMP"/g.dot) -eq $((2 * S + 1 + N)) ] || { echo "FAIL: vertices"; exit 1; }
+[ $(grep -c -- "->" "$TMP"/g.dot) -eq $((3 * N)) ] || { echo "FAIL: edges"; exit 1; }
+
+for j in 1 8; do
+    t=$(now)
+    "$TOP"/topo-builder -c "$TMP"/big.conf -x -d -n -j $j > "$TMP"/run.txt 2>/dev/null || { echo "FAIL: dry run -j $j"; exit 1; }
+    printf "%d nodes: dry run -j %d %d ms\n" $N $j $(( ($(now) - t) / 1000000 ))
+    [ $(grep -c "^sh " "$TMP"/run.txt) -eq $((2 * S + 1 + N)) ] || { echo "FAIL: commands scheduled -j $j"; exit 1; }
+done
+
+# quote and backslash in a switch name...
+
+cat > "$TMP"/esc.conf <<'EOF'
+switches = [ ( "a\\b\"c" bridge ) ]
+nodes = [ ( r1 image "x.img" tty 1 [ 10.0.0.1/24 -> "a\\b\"c" ] ) ]
+EOF
+
+"$TOP"/topo-builder -c "$TMP"/esc.conf -g | grep -qF 'label="bridge a\\b\"c\nrank' || { echo "FAIL: label escape"; exit 1; }
+
+echo "PASS"
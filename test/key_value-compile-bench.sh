@@ -0,0 +1,101 @@
+#!/bin/sh
+#
+# compile time of key_value_pack: for packs of 10 to 200 keys, generate a
+# translation unit that declares the keys (int, string, vector<int>),
+# loads a config with all of them, reads every key back with more::get and
+# checks the values, then compile it and run it. Prints the wall time and
+# the GC memory of the compiler (-ftime-report) for each size.
+#
+# usage: key_value-compile-bench.sh [sizes...]   (make compile-bench)
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+CXX=${CXX:-g++}
+SIZES=${*:-10 25 50 100 200}
+
+generate()
+{
+    n=$1
+
+    echo "#include <key_value.hpp>"
+    echo "#include <sstream>"
+    echo
+
+    i=0
+    while [ $i -lt $n ]; do
+        case $((i % 3)) in
+        0) echo "MAP_KEY(int, k$i)" ;;
+        1) echo "MAP_KEY_VALUE(std::string, k$i, \"none\")" ;;
+        2) echo "MAP_KEY(std::vector<int>, k$i)" ;;
+        esac
+        i=$((i + 1))
+    done
+
+    printf "\ntypedef more::key_value_pack<"
+    i=0
+    while [ $i -lt $n ]; do
+        [ $i -gt 0 ] && printf ", "
+        printf "k%d" $i
+        i=$((i + 1))
+    done
+    printf "> pack;\n\n"
+
+    echo "int main()"
+    echo "{"
+    echo "    std::istringstream in("
+    i=0
+    while [ $i -lt $n ]; do
+        case $((i % 3)) in
+        0) printf '        "k%d = %d\\n"\n' $i $i ;;
+        1) [ $((i % 2)) -eq 0 ] && printf '        "k%d = \\"s%d\\"\\n"\n' $i $i ;;
+        2) printf '        "k%d = [ %d %d ]\\n"\n' $i $i $i ;;
+        esac
+        i=$((i + 1))
+    done
+    printf '        "unknown = 1\\n");\n'
+    echo
+    echo "    pack p;"
+    echo "    if (!p.load(in, std::make_tuple(false, '=', '#', \"bench\")) || p.has_key(\"unknown\"))"
+    echo "        return 1;"
+    echo
+    echo "    int bad = 0;"
+    i=0
+    while [ $i -lt $n ]; do
+        case $((i % 3)) in
+        0) echo "    bad += more::get<k$i>(p) != $i;" ;;
+        1) if [ $((i % 2)) -eq 0 ]; then
+               echo "    bad += more::get<k$i>(p) != \"s$i\";"
+           else
+               echo "    bad += more::get<k$i>(p) != \"none\";"
+           fi ;;
+        2) echo "    bad += more::get<k$i>(p).size() != 2 || more::get<k$i>(p)[1] != $i;" ;;
+        esac
+        i=$((i + 1))
+    done
+    echo "    return bad;"
+    echo "}"
+}
+
+now()
+{
+    date +%s%N
+}
+
+for n in $SIZES; do
+    generate $n > "$TMP"/pack$n.cpp
+
+    start=$(now)
+    $CXX -std=c++0x -O2 -I"$TOP"/lib -ftime-report -o "$TMP"/pack$n "$TMP"/pack$n.cpp 2> "$TMP"/report$n ||
+        { cat "$TMP"/report$n; echo "FAIL: $n keys: compile"; exit 1; }
+    end=$(now)
+
+    "$TMP"/pack$n || { echo "FAIL: $n keys: values"; exit 1; }
+
+    mem=$(awk '/TOTAL/ { print $NF }' "$TMP"/report$n)
+    printf "%4d keys: %6d ms, %s GC memory\n" $n $(( (end - start) / 1000000 )) "$mem"
+done
+
+echo "PASS"
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# boot-readiness monitor: run the example topology against the stubs in
+# test/stub (startmv.sh prints "login:" after STUB_BOOT seconds), then
+# follow logs written by hand, without executing anything.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$TOP"/test/stub/* "$TMP" && cd "$TMP" || exit 1
+
+STUB_BOOT=1 "$TOP"/topo-builder -c "$TOP"/example/simple.conf -x -j 4 -M -T 10 2> out.txt || { echo "FAIL: monitor"; cat out.txt; exit 1; }
+grep -q "monitor: 2/2 ready" out.txt || { echo "FAIL: report"; cat out.txt; exit 1; }
+grep -q "monitor: vrouter1 ready [0-9]* ms" out.txt || { echo "FAIL: per-VM report"; cat out.txt; exit 1; }
+
+# VMs still running after the launch grace: the time to ready counts
+# from their own launch, not from the end of the plan...
+
+for mode in "" "-d"; do
+    STUB_BOOT=2 STUB_RUN=1 "$TOP"/topo-builder -c "$TOP"/example/simple.conf -x -M -T 10 --launch-grace 1500 $mode 2> out.txt || { echo "FAIL: monitor $mode"; cat out.txt; exit 1; }
+    pkill -f "[s]tartmv.sh -k -n"
+    for ms in $(sed -n "s/^monitor: vrouter[01] ready \([0-9]*\) ms$/\1/p" out.txt); do
+        [ $ms -ge 1900 ] && [ $ms -lt 3000 ] || { echo "FAIL: launch to ready $ms ms $mode"; exit 1; }
+    done
+    grep -q "monitor: 2/2 ready" out.txt || { echo "FAIL: report $mode"; cat out.txt; exit 1; }
+done
+
+rm -f log-*.txt
+"$TOP"/topo-builder -c "$TOP"/example/simple.conf -x -M -T 1 -R "never printed" 2> out.txt && { echo "FAIL: timeout not reported"; exit 1; }
+grep -q "monitor: vrouter0 not ready" out.txt || { echo "FAIL: timeout report"; cat out.txt; exit 1; }
+
+# monitor only: a log already ready, one created later, the pattern
+# split across two writes...
+#
+
+rm -f log-*.txt
+echo "booting... login:" > log-1.txt
+( sleep 1; printf "booting... log" > log-2.txt; sleep 1; echo "in:" >> log-2.txt ) &
+"$TOP"/topo-builder -c "$TOP"/example/simple.conf -M -T 10 2> out.txt || { echo "FAIL: monitor only"; cat out.txt; exit 1; }
+grep -q "monitor: 2/2 ready" out.txt || { echo "FAIL: monitor only report"; cat out.txt; exit 1; }
+
+echo "PASS"
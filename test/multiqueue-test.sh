@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# NIC settings of the multiqueue example: multiqueue taps passed to
+# vnet-setup.sh -q, queues (vCPUs by default), vhost-net and offload
+# flags in the -Q options of startmv.sh; offload values that are not a
+# list of flags, queues that are not a number up to 256, and keys naming
+# no switch, node or port are rejected.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cd "$TMP" || exit 1
+
+"$TOP"/topo-builder -c "$TOP"/example/multiqueue.conf > run.sh 2>/dev/null || { echo "FAIL: build"; exit 1; }
+
+grep -qF 'vnet-setup.sh -B vswitch0 -z -m 1 -n 2 -q "1 2"' run.sh || { echo "FAIL: multiqueue taps"; exit 1; }
+grep -qF -- '-Q "-smp 4 -netdev tap,id=net0,ifname=tap1,script=no,downscript=no,queues=4,vhost=on -device virtio-net-pci,netdev=net0,mq=on,vectors=10"' run.sh || { echo "FAIL: vrouter0 NIC"; exit 1; }
+grep -qF -- '-Q "-smp 2 -netdev tap,id=net0,ifname=tap2,script=no,downscript=no,queues=2,vhost=on -device virtio-net-pci,netdev=net0,mq=on,vectors=6,csum=on,gso=on,guest_ufo=off"' run.sh || { echo "FAIL: vrouter1 NIC"; exit 1; }
+
+# the port settings override the node ones (a default NIC: plain tap)...
+
+sed 's/"vrouter1:0"    -> \[ offload csum,gso,-guest_ufo \]/"vrouter1:0" -> [ queues 1 vhost off ]/' "$TOP"/example/multiqueue.conf > port.conf
+"$TOP"/topo-builder -c port.conf 2>/dev/null | grep -qF -- '-I "tap2" -Q "-smp 2"' || { echo "FAIL: port settings"; exit 1; }
+
+# invalid offload flags...
+
+for f in '"csum;reboot"' '"csum gso"' CSUM csum,,gso csum, - '"$(id)"'; do
+    sed "s/offload csum,gso,-guest_ufo/offload $f/" "$TOP"/example/multiqueue.conf > bad.conf
+    "$TOP"/topo-builder -c bad.conf >/dev/null 2>&1 && { echo "FAIL: offload $f accepted"; exit 1; }
+done
+
+# invalid queues...
+
+for q in 4abc 0 257 99999999999; do
+    sed "s/vrouter0        -> \[ smp 4 vhost on \]/vrouter0 -> [ queues $q ]/" "$TOP"/example/multiqueue.conf > bad.conf
+    "$TOP"/topo-builder -c bad.conf 2>&1 >/dev/null | grep -qF "settings: vrouter0: invalid queues value" || { echo "FAIL: queues $q accepted"; exit 1; }
+done
+
+sed "s/vrouter0        -> \[ smp 4 vhost on \]/vrouter0 -> [ queues 256 ]/" "$TOP"/example/multiqueue.conf > max.conf
+"$TOP"/topo-builder -c max.conf 2>/dev/null | grep -qF "queues=256 -device virtio-net-pci,netdev=net0,mq=on,vectors=514" || { echo "FAIL: queues 256"; exit 1; }
+
+# unknown keys, settings not at their level...
+
+for s in 'vrouter9 -> [ smp 2 ]' '"vrouter0:1" -> [ queues 2 ]' '"vrouter0:x" -> [ queues 2 ]' \
+         '"vrouter0:0" -> [ smp 2 ]' 'vswitch0 -> [ vhost on ]'; do
+    sed "s/vrouter0        -> \[ smp 4 vhost on \]/$s/" "$TOP"/example/multiqueue.conf > bad.conf
+    "$TOP"/topo-builder -c bad.conf 2>&1 >/dev/null | grep -q "^settings: " || { echo "FAIL: $s accepted"; exit 1; }
+done
+
+echo "PASS"
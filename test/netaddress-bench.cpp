@@ -0,0 +1,128 @@
+//
+// net::format vs inet_ntop: same text for every octet value and prefix,
+// then the time to format millions of addresses (the old show(), the new
+// show(), format into a buffer, append_to a reused string).
+//
+// g++ -std=c++0x -O3 -I lib test/netaddress-bench.cpp -o netaddress-bench
+//
+
+#include <netaddress.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    int failed = 0;
+
+    // the former net::show()...
+    //
+
+    std::string
+    show_ntop(const net::address &addr)
+    {
+        char buf[16] = { '\0' };
+        inet_ntop(AF_INET, &addr.addr(), buf, sizeof(buf));
+        return std::string(buf) + '/' + std::to_string(addr.prefix());
+    }
+
+    void
+    check(net::address const &addr)
+    {
+        char buf[net::format_buffer_size];
+        std::string s(buf, net::format(addr, buf));
+
+        if (s != show_ntop(addr) || net::show(addr) != s) {
+            std::cerr << "FAIL: [" << s << "] != [" << show_ntop(addr) << "]" << std::endl;
+            failed++;
+        }
+    }
+
+    template <typename Fun>
+    double
+    bench(Fun fun, std::vector<net::address> const &as)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t len = 0;
+        for(auto & a : as)
+            len += fun(a);
+        auto d = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / as.size();
+        if (len == 0)
+            std::cerr << "?";
+        return d;
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 4000000;
+
+    // every octet value in every position, every prefix...
+    //
+
+    for(uint32_t v = 0; v < 256; ++v)
+    {
+        for(int pos = 0; pos < 4; ++pos)
+        {
+            in_addr a;
+            a.s_addr = htonl((v << (8 * pos)) | (pos ? 0x0a000001 & ~(0xffu << (8 * pos)) : 0));
+            check(net::address(a, 32));
+        }
+    }
+
+    for(size_t p = 0; p <= 32; ++p)
+        check(net::address("255.255.255.255", p));
+
+    // benchmark: pseudo-random addresses, prefixes 8..32
+    //
+
+    std::vector<net::address> as;
+    as.reserve(n);
+
+    uint32_t x = 2463534242u;
+    for(size_t i = 0; i < n; ++i)
+    {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        in_addr a;
+        a.s_addr = htonl(x);
+        as.push_back(net::address(a, 8 + x % 25));
+    }
+
+    for(size_t i = 0; i < as.size(); i += 997)
+        check(as[i]);
+
+    auto t0 = bench([](net::address const &a) {
+        return show_ntop(a).size();
+    }, as);
+
+    auto t1 = bench([](net::address const &a) {
+        return net::show(a).size();
+    }, as);
+
+    char buf[net::format_buffer_size];
+    auto t2 = bench([&](net::address const &a) {
+        return static_cast<size_t>(net::format(a, buf) - buf);
+    }, as);
+
+    std::string out;
+    auto t3 = bench([&](net::address const &a) {
+        out.clear();
+        net::append_to(out, a);
+        return out.size();
+    }, as);
+
+    std::cout << as.size() << " addresses" << std::endl;
+    std::cout << "inet_ntop + strings      : " << t0 << " ns/address" << std::endl;
+    std::cout << "show                     : " << t1 << " ns/address" << std::endl;
+    std::cout << "format (buffer)          : " << t2 << " ns/address" << std::endl;
+    std::cout << "append_to (reused)       : " << t3 << " ns/address" << std::endl;
+
+    if (failed)
+        return 1;
+
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# run the example topology with --execute --netlink inside an unprivileged
+# user+net namespace: bridges and taps must be created, enslaved and up;
+# a second run must detect the collisions before creating anything.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$TOP"/test/stub/*.sh "$TMP" && cd "$TMP" || exit 1
+
+exec unshare -Urn sh -e -c '
+    "$1"/topo-builder -c "$1"/example/simple.conf -x -N -d -j 4 || { echo "FAIL: execute"; exit 1; }
+
+    for t in tap1 tap2; do
+        ip -o link show $t | grep -q "master vswitch0" || { echo "FAIL: $t not enslaved"; exit 1; }
+    done
+    for t in tap3 tap4; do
+        ip -o link show $t | grep -q "master vswitch1" || { echo "FAIL: $t not enslaved"; exit 1; }
+    done
+    ip -o link show vswitch0 | grep -q ",UP" || { echo "FAIL: vswitch0 down"; exit 1; }
+
+    if "$1"/topo-builder -c "$1"/example/simple.conf -x -N 2>err.txt; then
+        echo "FAIL: collision not detected"; exit 1
+    fi
+    grep -q "already exist" err.txt || { echo "FAIL: unexpected error"; cat err.txt; exit 1; }
+
+    echo PASS
+' sh "$TOP"
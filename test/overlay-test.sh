@@ -0,0 +1,62 @@
+#!/bin/sh
+#
+# run the overlay example with --execute against the stubs in test/stub
+# (qemu-img included): each VM gets its own overlay on the shared base,
+# created before the VM is started, with phases and with the graph. An
+# existing overlay is kept, the format of the base is the one given by
+# qemu-img info, and a failing overlay only holds back its own VM.
+# Quotes in the paths do not break (or inject into) the commands.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$TOP"/test/stub/* "$TMP" && cd "$TMP" || exit 1
+PATH="$TMP:$PATH"; export PATH
+
+for mode in "" "-d"; do
+    rm -rf ovl qemu-img.log log-*.txt
+    "$TOP"/topo-builder -c "$TOP"/example/overlay.conf -x -j 4 -O ovl $mode 2>/dev/null || { echo "FAIL: execute $mode"; exit 1; }
+    sleep 1
+    for vm in vrouter0 vrouter1 vrouter2; do
+        [ -e ovl/$vm.qcow2 ] || { echo "FAIL: overlay $vm $mode"; exit 1; }
+    done
+    grep -q -- "-b $TMP/base.qcow2 ovl/vrouter0.qcow2" qemu-img.log || { echo "FAIL: base path $mode"; exit 1; }
+    grep -q -- "-b /srv/images/router.qcow2 ovl/vrouter2.qcow2" qemu-img.log || { echo "FAIL: absolute base $mode"; exit 1; }
+    grep -q -- "-F qcow2 -b $TMP/base.qcow2 ovl/vrouter0.qcow2" qemu-img.log || { echo "FAIL: base format $mode"; exit 1; }
+    grep -q -- "-q ovl/vrouter1.qcow2" log-2.txt || { echo "FAIL: VM not on overlay $mode"; exit 1; }
+
+    # the overlays of the guests are kept...
+    rm -f qemu-img.log
+    "$TOP"/topo-builder -c "$TOP"/example/overlay.conf -x -j 4 -O ovl $mode 2>err.txt || { echo "FAIL: execute again $mode"; exit 1; }
+    grep -qs "create" qemu-img.log && { echo "FAIL: overlay created again $mode"; exit 1; }
+    [ $(grep -c "exists, kept" err.txt) -eq 3 ] || { echo "FAIL: overlays not reported as kept $mode"; exit 1; }
+done
+
+# raw base image...
+
+rm -rf ovl qemu-img.log
+sed 's/"base.qcow2"/"base.img"/' "$TOP"/example/overlay.conf > raw.conf
+"$TOP"/topo-builder -c raw.conf -x -O ovl 2>/dev/null || { echo "FAIL: raw base"; exit 1; }
+grep -q -- "-F raw -b $TMP/base.img ovl/vrouter0.qcow2" qemu-img.log || { echo "FAIL: raw base format"; exit 1; }
+
+# quotes and command substitutions in the paths are data...
+
+for mode in "" "-d"; do
+    rm -rf "o'v" qemu-img.log log-*.txt pwned
+    sed "s|\"base.qcow2\"|\"b'\$(touch\${IFS}pwned)'.qcow2\"|" "$TOP"/example/overlay.conf > quote.conf
+    "$TOP"/topo-builder -c quote.conf -x -O "o'v" $mode 2>/dev/null || { echo "FAIL: quoted paths $mode"; exit 1; }
+    sleep 1
+    [ -e pwned ] && { echo "FAIL: command injected $mode"; exit 1; }
+    grep -qF -- "-b $TMP/b'\$(touch\${IFS}pwned)'.qcow2 o'v/vrouter0.qcow2" qemu-img.log || { echo "FAIL: quoted base $mode"; exit 1; }
+    grep -qF -- "-q o'v/vrouter1.qcow2" log-2.txt || { echo "FAIL: quoted overlay $mode"; exit 1; }
+done
+
+rm -rf overlay log-*.txt
+STUB_FAIL=vrouter1 "$TOP"/topo-builder -c "$TOP"/example/overlay.conf -x -j 4 -d 2>/dev/null && { echo "FAIL: error not reported"; exit 1; }
+sleep 1
+[ -e log-2.txt ] && { echo "FAIL: VM started without its overlay"; exit 1; }
+[ -e log-1.txt ] || { echo "FAIL: independent VM not started"; exit 1; }
+
+echo "PASS"
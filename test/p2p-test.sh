@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# run the p2p example with --execute against the stubs in test/stub: the
+# two ends of a link send to each other's UDP port (--p2p-port + port
+# index), no host device is made for a p2p switch (with phases and with
+# the graph). A p2p switch has exactly two ports, UDP ports past 65535
+# are rejected, and the teardown finds the VMs by their local address.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$TOP"/test/stub/* "$TMP" && cd "$TMP" || exit 1
+PATH="$TMP:$PATH"; export PATH
+
+for mode in "" "-d"; do
+    rm -f log-*.txt
+    "$TOP"/topo-builder -c "$TOP"/example/p2p.conf -x -j 4 --p2p-port 30000 $mode > run.txt 2>/dev/null || { echo "FAIL: execute $mode"; exit 1; }
+    sleep 1
+    grep -qF -- "-netdev socket,id=net0,udp=127.0.0.1:30003,localaddr=127.0.0.1:30002 -device virtio-net-pci,netdev=net0 -netdev tap,id=net1,ifname=tap1," log-1.txt || { echo "FAIL: vrouter0 NICs $mode"; exit 1; }
+    grep -qF -- "-netdev socket,id=net0,udp=127.0.0.1:30002,localaddr=127.0.0.1:30003 -device virtio-net-pci,netdev=net0 -netdev socket,id=net1,udp=127.0.0.1:30005,localaddr=127.0.0.1:30004 " log-2.txt || { echo "FAIL: vrouter1 NICs $mode"; exit 1; }
+    grep -qF -- "-netdev socket,id=net0,udp=127.0.0.1:30004,localaddr=127.0.0.1:30005 " log-3.txt || { echo "FAIL: vrouter2 NICs $mode"; exit 1; }
+done
+
+"$TOP"/topo-builder -c "$TOP"/example/p2p.conf -x -n > run.txt 2>/dev/null || { echo "FAIL: dry run"; exit 1; }
+grep -q "link01\|link12" run.txt && { echo "FAIL: host device for a p2p switch"; exit 1; }
+
+# two ports per link, UDP ports in range...
+
+sed 's|10.0.2.2/30     -> link12|& 10.0.2.3/30 -> link12|' "$TOP"/example/p2p.conf > three.conf
+"$TOP"/topo-builder -c three.conf 2>&1 >/dev/null | grep -q "p2p switch link12 has 3 ports (2 required)" || { echo "FAIL: 3 ports accepted"; exit 1; }
+
+"$TOP"/topo-builder -c "$TOP"/example/p2p.conf --p2p-port 65533 2>&1 >/dev/null | grep -q "UDP port 65536 out of range" || { echo "FAIL: UDP port out of range accepted"; exit 1; }
+
+"$TOP"/topo-builder -c "$TOP"/example/p2p.conf -D > down.txt 2>/dev/null || { echo "FAIL: teardown"; exit 1; }
+grep -qF "[l]ocaladdr=127.0.0.1:20002([^0-9]|\$)|[l]ocaladdr=127.0.0.1:20003([^0-9]|\$)|[l]ocaladdr=127.0.0.1:20005([^0-9]|\$)" down.txt || { echo "FAIL: teardown VMs"; exit 1; }
+
+echo "PASS"
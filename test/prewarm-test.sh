@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# run the overlay example with --execute --prewarm --initrd-cache against
+# the stubs in test/stub: kernel, core and shared base are prewarmed (the
+# missing base reported), the core is decompressed once into the cache,
+# before the VMs that boot on it; the cache is reused as long as it is
+# newer than the core.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$TOP"/test/stub/* "$TMP" && cd "$TMP" || exit 1
+PATH="$TMP:$PATH"; export PATH
+
+mkdir -p Core/boot
+head -c 3000000 /dev/urandom > Core/boot/vmlinuz
+head -c 2000000 /dev/urandom > core.cpio
+gzip -c core.cpio > Core/boot/core.gz
+head -c 5000000 /dev/zero > base.qcow2
+
+for mode in "" "-d"; do
+    rm -f log-*.txt
+    "$TOP"/topo-builder -c "$TOP"/example/overlay.conf -x -j 4 $mode --prewarm --initrd-cache cache 2> err.txt || { cat err.txt; echo "FAIL: execute $mode"; exit 1; }
+    sleep 1
+    grep -q "prewarm: /srv/images/router.qcow2: not found" err.txt || { echo "FAIL: missing base not reported $mode"; exit 1; }
+    grep -q "prewarm: 3 files, 10 MB" err.txt || { cat err.txt; echo "FAIL: prewarm summary $mode"; exit 1; }
+    cmp -s core.cpio cache/core.cpio || { echo "FAIL: initrd cache $mode"; exit 1; }
+    grep -q -- "-c cache/core.cpio" log-1.txt || { echo "FAIL: VM not booted on the cache $mode"; exit 1; }
+done
+
+# up to date: not decompressed again; stale: refreshed...
+
+touch -d "1 hour ago" Core/boot/core.gz
+before=$(ls -i cache/core.cpio)
+"$TOP"/topo-builder -c "$TOP"/example/overlay.conf -x -j 4 --initrd-cache cache 2>/dev/null || { echo "FAIL: execute (cached)"; exit 1; }
+[ "$(ls -i cache/core.cpio)" = "$before" ] || { echo "FAIL: cache rewritten"; exit 1; }
+
+head -c 1000 /dev/urandom > core.cpio
+gzip -c core.cpio > Core/boot/core.gz
+touch -d "1 hour" Core/boot/core.gz
+"$TOP"/topo-builder -c "$TOP"/example/overlay.conf -x -j 4 --initrd-cache cache 2>/dev/null || { echo "FAIL: execute (stale)"; exit 1; }
+cmp -s core.cpio cache/core.cpio || { echo "FAIL: stale cache kept"; exit 1; }
+
+"$TOP"/topo-builder -c "$TOP"/example/overlay.conf --prewarm >/dev/null 2>&1 && { echo "FAIL: --prewarm without --execute"; exit 1; }
+
+echo "PASS"
@@ -0,0 +1,130 @@
+//
+// more::format vs more::sprint: same output, then the time to format the
+// startmv.sh command line of a VM (the template used by script.cpp).
+//
+// g++ -std=c++0x -O3 -I lib test/print-bench.cpp -o print-bench
+//
+
+#include <print.hpp>
+
+#include <chrono>
+#include <climits>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    const char *startvm = "startmv.sh -k -n %1 %2 %3 -l %4 -c %5 %7 </dev/zero &>log-%6.txt &";
+
+    struct opt
+    {
+        std::string name;
+        int value;
+    };
+
+    std::ostream &
+    operator<<(std::ostream &out, opt const &o)
+    {
+        return out << o.name << ' ' << o.value;
+    }
+
+    int failed = 0;
+
+    void
+    check(std::string const &a, std::string const &b)
+    {
+        if (a != b) {
+            std::cerr << "FAIL: [" << a << "] != [" << b << "]" << std::endl;
+            failed++;
+        }
+    }
+
+    template <typename Fun>
+    double
+    bench(Fun fun, int n)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t len = 0;
+        for(int i = 0; i < n; ++i)
+            len += fun(i);
+        auto d = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+        if (len == 0)
+            std::cerr << "?";
+        return d;
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    int n = argc > 1 ? std::stoi(argv[1]) : 1000000;
+
+    // same output as sprint...
+    //
+
+    const char *fmts[] = { "", "plain", "%1", "%%1 %1%%", "%1%2", "[%2] [%1] [%2]", "%10", "a %3 b %1" };
+
+    for(auto f : fmts)
+    {
+        if (std::string(f) == "%10")
+        {
+            check(more::format(f)(1,2,3,4,5,6,7,8,9,"x"), more::sprint(f,1,2,3,4,5,6,7,8,9,"x"));
+            continue;
+        }
+        check(more::format(f)(std::string("s"), -42, 'c'), more::sprint(f, std::string("s"), -42, 'c'));
+    }
+
+    check(more::format("%1 %2 %3 %4 %5")(INT_MIN, LLONG_MAX, 0u, true, opt{"-t", 1}),
+          more::sprint("%1 %2 %3 %4 %5", INT_MIN, LLONG_MAX, 0u, true, opt{"-t", 1}));
+
+    try {
+        more::format("%1 %2")(1);
+        check("no error", "error");
+    }
+    catch(std::runtime_error &) {}
+
+    try {
+        more::format("100%");
+        check("no error", "error");
+    }
+    catch(std::runtime_error &) {}
+
+    // benchmark...
+    //
+
+    std::string nic = "-I \"tap1 tap2 tap3\"";
+    std::string img = "-q overlay/vrouter0.qcow2";
+    std::string vmlinuz = "Core/boot/vmlinuz", core = "Core/boot/core.gz", append = "-a ifaces=eth0-10.0.0.1/24";
+
+    auto t0 = bench([&](int i) {
+        return more::sprint(startvm, opt{"-t", i}, nic, img, vmlinuz, core, i, append).size();
+    }, n);
+
+    static const more::format f(startvm);
+
+    auto t1 = bench([&](int i) {
+        return f(opt{"-t", i}, nic, img, vmlinuz, core, i, append).size();
+    }, n);
+
+    auto t2 = bench([&](int i) {
+        return f("-t ", nic, img, vmlinuz, core, i, append).size();
+    }, n);
+
+    std::string buf;
+    auto t3 = bench([&](int i) {
+        buf.clear();
+        f.append(buf, "-t ", nic, img, vmlinuz, core, i, append);
+        return buf.size();
+    }, n);
+
+    std::cout << "sprint                   : " << t0 << " ns/call" << std::endl;
+    std::cout << "format (streamed arg)    : " << t1 << " ns/call" << std::endl;
+    std::cout << "format                   : " << t2 << " ns/call" << std::endl;
+    std::cout << "format::append (reused)  : " << t3 << " ns/call" << std::endl;
+
+    if (failed)
+        return 1;
+
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
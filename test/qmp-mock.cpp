@@ -0,0 +1,98 @@
+//
+// minimal QMP server for qmp-test.sh: listens on a unix socket, sends the
+// greeting, answers every command with an empty return and logs the
+// commands (one per line) to stdout. Exits when the client disconnects.
+//
+// device_del is asynchronous, as with a real guest: DEVICE_DELETED comes
+// 300 ms after the return, and a netdev_del before it is an error. Events
+// begin with their timestamp, as QEMU sends them.
+//
+// usage: qmp-mock socket [error-pattern]
+//
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+        return 2;
+
+    sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, argv[1], sizeof(sa.sun_path) - 1);
+
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(argv[1]);
+    if (s < 0 || bind(s, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0 || listen(s, 1) < 0)
+        return perror("qmp-mock"), 1;
+
+    int c = accept(s, nullptr, nullptr);
+    if (c < 0)
+        return perror("qmp-mock"), 1;
+
+    std::string greeting("{\"QMP\": {\"version\": {}, \"capabilities\": []}}\r\n");
+    if (write(c, greeting.data(), greeting.size()) < 0)
+        return 1;
+
+    std::string in, deleting;
+    char buf[1024];
+
+    for(;;)
+    {
+        // the pending DEVICE_DELETED event...
+
+        pollfd pfd = { c, POLLIN, 0 };
+        if (poll(&pfd, 1, deleting.empty() ? -1 : 300) == 0)
+        {
+            std::string event = "{\"timestamp\": {\"seconds\": 1700000000, \"microseconds\": 42}, \"event\": \"DEVICE_DELETED\", \"data\": {\"device\": \"" + deleting + "\", \"path\": \"/machine/peripheral/" + deleting + "\"}}\r\n";
+            printf("event DEVICE_DELETED %s\n", deleting.c_str());
+            fflush(stdout);
+            deleting.clear();
+            if (write(c, event.data(), event.size()) < 0)
+                return 1;
+            continue;
+        }
+
+        auto n = read(c, buf, sizeof(buf));
+        if (n <= 0)
+            break;
+
+        in.append(buf, static_cast<size_t>(n));
+
+        size_t pos;
+        while ((pos = in.find('\n')) != std::string::npos)
+        {
+            auto cmd = in.substr(0, pos);
+            in.erase(0, pos + 1);
+
+            printf("%s\n", cmd.c_str());
+            fflush(stdout);
+
+            std::string reply = (argc > 2 && cmd.find(argv[2]) != std::string::npos) ?
+                "{\"error\": {\"class\": \"GenericError\", \"desc\": \"mock failure\"}}\r\n" :
+                (cmd.find("netdev_del") != std::string::npos && !deleting.empty()) ?
+                "{\"error\": {\"class\": \"GenericError\", \"desc\": \"netdev in use\"}}\r\n" :
+                "{\"timestamp\": {\"seconds\": 1700000000, \"microseconds\": 7}, \"event\": \"NIC_RX_FILTER_CHANGED\", \"data\": {\"path\": \"/machine/peripheral/x\"}}\r\n{\"return\": {}}\r\n";
+
+            auto id = cmd.find("\"id\":\"nic-");
+            if (cmd.find("device_del") != std::string::npos && id != std::string::npos)
+                deleting = cmd.substr(id + 6, cmd.find('"', id + 6) - id - 6);
+
+            if (write(c, reply.data(), reply.size()) < 0)
+                return 1;
+        }
+    }
+
+    close(c);
+    unlink(argv[1]);
+    return 0;
+}
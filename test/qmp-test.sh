@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# hot-plug the NICs of the example topology against mock QMP servers
+# (test/qmp-mock.cpp), inside an unprivileged user+net namespace:
+# vrouter0 gains a port on vswitch1 (a new tap enslaved to the bridge,
+# recorded in the state file), vrouter1 loses its port on vswitch0 (its
+# netdev deleted once the device is gone); an error from QMP must be
+# reported, and switches other than bridges are rejected.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+${CXX:-g++} -std=c++0x -O2 -o "$TMP"/qmp-mock "$TOP"/test/qmp-mock.cpp || { echo "FAIL: build mock"; exit 1; }
+
+sed -e 's|192.168.1.1/24  -> vswitch1|&\n                       192.168.2.1/24  -> vswitch1|' \
+    -e 's|192.168.0.2/24  -> vswitch0||' "$TOP"/example/simple.conf > "$TMP"/new.conf
+
+"$TOP"/topo-builder -c "$TMP"/new.conf -Q "$TMP" | grep -q -- "-qmp unix:$TMP/vrouter0.sock" || { echo "FAIL: no -qmp option"; exit 1; }
+
+sed 's/( vswitch1 bridge )/( vswitch1 vale )/' "$TMP"/new.conf > "$TMP"/vale.conf
+"$TOP"/topo-builder -c "$TMP"/vale.conf -Q "$TMP" -H "$TOP"/example/simple.conf -n 2>&1 >/dev/null | grep -q "vale switch vswitch1 not supported" || { echo "FAIL: vale NIC hot-plugged"; exit 1; }
+
+cd "$TMP" || exit 1
+
+exec unshare -Urn sh -e -c '
+    mock()
+    {
+        for vm in vrouter0 vrouter1; do
+            ./qmp-mock $vm.sock $1 > $vm.log &
+        done
+        sleep 1
+    }
+
+    ip link add vswitch0 type bridge
+    ip link add vswitch1 type bridge
+    ip tuntap add dev tap4 mode tap
+
+    mock
+    "$1"/topo-builder -c new.conf -Q . -H "$1"/example/simple.conf -S state.txt || { echo "FAIL: hotplug"; exit 1; }
+    wait
+
+    ip -o link show tap5 | grep -q "master vswitch1" || { echo "FAIL: tap5 not enslaved"; exit 1; }
+    grep -qx "tap tap5" state.txt || { echo "FAIL: tap5 not in the state file"; exit 1; }
+
+    grep -q "\"netdev_add\".*\"type\":\"tap\",\"id\":\"net-vswitch1-1\",\"ifname\":\"tap5\"" vrouter0.log || { echo "FAIL: netdev_add"; exit 1; }
+    grep -q "\"device_add\".*\"id\":\"nic-vswitch1-1\"" vrouter0.log || { echo "FAIL: device_add"; exit 1; }
+    grep -q "\"device_del\".*\"nic-vswitch0-0\"" vrouter1.log || { echo "FAIL: device_del"; exit 1; }
+    sed -n "/^event DEVICE_DELETED nic-vswitch0-0$/,\$p" vrouter1.log | grep -q "\"netdev_del\".*\"net-vswitch0-0\"" || { echo "FAIL: netdev_del before DEVICE_DELETED"; exit 1; }
+
+    mock device_add
+    "$1"/topo-builder -c new.conf -Q . -H "$1"/example/simple.conf 2>/dev/null && { echo "FAIL: error not reported"; exit 1; }
+    wait
+
+    echo PASS
+' sh "$TOP"
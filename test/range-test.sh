@@ -0,0 +1,94 @@
+#!/bin/sh
+#
+# node templates: a config with ( vrouter[0..N-1] ... ) must give the same
+# plan as the one listing the N nodes one by one; malformed ranges and
+# placeholders (or ones that would overflow) are rejected. Prints the size of both configs and the time
+# to build them.
+#
+# usage: range-test.sh [N]   (default 10000)
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+N=${1:-10000}
+
+switches()
+{
+    echo "switches = ["
+    i=0
+    while [ $i -lt $(( (N + 99) / 100 )) ]; do
+        echo "( lan$i bridge )"
+        i=$((i + 1))
+    done
+    echo "( wan0 bridge ) ]"
+}
+
+{
+    switches
+    echo "nodes = ["
+    echo "( host0 image \"host.img\" tty 1 [ 172.16.0.1/16 -> wan0 ] )"
+    i=0
+    while [ $i -lt $N ]; do
+        echo "( vrouter$i overlay \"opt$((i % 4)).qcow2\" tty $((i + 2)) [ 10.$((i / 256)).$((i % 256)).1/16 -> lan$((i / 100)) 172.16.$((i / 200)).$((i % 200 + 2))/16 -> wan0 ] )"
+        i=$((i + 1))
+    done
+    echo "]"
+} > "$TMP"/plain.conf
+
+{
+    switches
+    echo "nodes = ["
+    echo "( host0 image \"host.img\" tty 1 [ 172.16.0.1/16 -> wan0 ] )"
+    echo "( vrouter[0..$((N - 1))] overlay \"opt{i%4}.qcow2\" tty {i+2} [ 10.{i/256}.{i%256}.1/16 -> lan{i/100} 172.16.{i/200}.{i%200+2}/16 -> wan0 ] )"
+    echo "]"
+} > "$TMP"/range.conf
+
+now()
+{
+    date +%s%N
+}
+
+start=$(now)
+"$TOP"/topo-builder -c "$TMP"/plain.conf -a > "$TMP"/plain.out || { echo "FAIL: plain config"; exit 1; }
+mid=$(now)
+"$TOP"/topo-builder -c "$TMP"/range.conf -a > "$TMP"/range.out || { echo "FAIL: range config"; exit 1; }
+end=$(now)
+
+cmp -s "$TMP"/plain.out "$TMP"/range.out || { echo "FAIL: plans differ"; exit 1; }
+
+printf "plain: %8d bytes, %5d ms\n" $(wc -c < "$TMP"/plain.conf) $(( (mid - start) / 1000000 ))
+printf "range: %8d bytes, %5d ms\n" $(wc -c < "$TMP"/range.conf) $(( (end - mid) / 1000000 ))
+
+# malformed templates...
+
+for t in "r[5..2]" "r[0..x]" "r[0-3]" "r[0..3] image \"a{j}.img\"" "r[0..3] image \"a{i/0}.img\"" "r[0..3] image \"a{i+}.img\""; do
+    case "$t" in
+    *image*) node="( $t tty {i} [ 10.0.0.{i}/24 -> wan0 ] )" ;;
+    *)       node="( $t image \"a.img\" tty {i} [ 10.0.0.{i}/24 -> wan0 ] )" ;;
+    esac
+    printf "switches = [ ( wan0 bridge ) ]\nnodes = [ %s ]\n" "$node" > "$TMP"/bad.conf
+    "$TOP"/topo-builder -c "$TMP"/bad.conf >/dev/null 2>&1 && { echo "FAIL: $t accepted"; exit 1; }
+done
+
+# out of range indices, first > last...
+
+for t in "r[0..99999999999]:index above 1000000" "r[0..99999999999999999999999]:index above 1000000" \
+         "r[1000001..1000002]:index above 1000000" "r[5..2]:invalid range (first > last)"; do
+    printf "switches = [ ( wan0 bridge ) ]\nnodes = [ ( %s image \"a.img\" tty {i} [ 10.0.0.1/24 -> wan0 ] ) ]\n" "${t%%:*}" > "$TMP"/bad.conf
+    "$TOP"/topo-builder -c "$TMP"/bad.conf 2>&1 >/dev/null | grep -qF "parser: r: ${t#*:}" || { echo "FAIL: ${t%%:*} accepted"; exit 1; }
+done
+
+# placeholders that would overflow...
+
+for t in "{i*99999999999999999999}:operand above 1000000" "{i+1000001}:operand above 1000000" \
+         "{i*1000000*1000000*1000000}:placeholder value out of range"; do
+    printf "switches = [ ( wan0 bridge ) ]\nnodes = [ ( r[0..3] image \"a%s.img\" tty {i} [ 10.0.0.1/24 -> wan0 ] ) ]\n" "${t%%:*}" > "$TMP"/bad.conf
+    "$TOP"/topo-builder -c "$TMP"/bad.conf 2>&1 >/dev/null | grep -qF "${t%%:*}.img\": ${t#*:}" || { echo "FAIL: ${t%%:*} accepted"; exit 1; }
+done
+
+printf "switches = [ ( wan0 bridge ) ]\nnodes = [ ( r[250..260] image \"a.img\" tty {i} [ 10.0.0.{i}/24 -> wan0 ] ) ]\n" > "$TMP"/bad.conf
+"$TOP"/topo-builder -c "$TMP"/bad.conf 2>&1 >/dev/null | grep -q "r256: invalid address 10.0.0.256/24" || { echo "FAIL: invalid address accepted"; exit 1; }
+
+echo "PASS"
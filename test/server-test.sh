@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# serve the examples from topo-builder --listen with the client in
+# test/topo-client.cpp: plans identical to the ones of a direct build,
+# the second request for a config (by path or inline) served from the
+# cache, concurrent requests, errors reported, socket removed on SIGTERM.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'kill $SERVER 2>/dev/null; rm -rf "$TMP"' EXIT
+
+${CXX:-g++} -std=c++0x -O2 -o "$TMP"/topo-client "$TOP"/test/topo-client.cpp || { echo "FAIL: build client"; exit 1; }
+
+"$TOP"/topo-builder -L "$TMP"/sock -j 4 2>/dev/null &
+SERVER=$!
+
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S "$TMP"/sock ] && break
+    sleep 0.1
+done
+
+client()
+{
+    "$TMP"/topo-client "$TMP"/sock "$@"
+}
+
+"$TOP"/topo-builder -c "$TOP"/example/simple.conf -i > "$TMP"/direct 2>/dev/null
+
+client -c "$TOP"/example/simple.conf -i > "$TMP"/plan 2> "$TMP"/cache || { echo "FAIL: request"; exit 1; }
+cmp -s "$TMP"/direct "$TMP"/plan || { echo "FAIL: plan differs"; exit 1; }
+grep -q miss "$TMP"/cache || { echo "FAIL: first request cached"; exit 1; }
+
+client -i < "$TOP"/example/simple.conf > "$TMP"/plan 2> "$TMP"/cache || { echo "FAIL: inline request"; exit 1; }
+cmp -s "$TMP"/direct "$TMP"/plan || { echo "FAIL: inline plan differs"; exit 1; }
+grep -q hit "$TMP"/cache || { echo "FAIL: same content not cached"; exit 1; }
+
+CLIENTS=
+for conf in simple multiqueue overlay; do
+    for fmt in sh json bin; do
+        "$TOP"/topo-builder -c "$TOP"/example/$conf.conf -f $fmt > "$TMP"/$conf.$fmt.direct 2>/dev/null
+        client -c "$TOP"/example/$conf.conf -f $fmt > "$TMP"/$conf.$fmt 2>/dev/null &
+        CLIENTS="$CLIENTS $!"
+    done
+done
+wait $CLIENTS
+
+for conf in simple multiqueue overlay; do
+    for fmt in sh json bin; do
+        cmp -s "$TMP"/$conf.$fmt.direct "$TMP"/$conf.$fmt || { echo "FAIL: concurrent $conf.$fmt"; exit 1; }
+    done
+done
+
+printf "[nodes]\nbroken\n" | client 2>/dev/null && { echo "FAIL: error not reported"; exit 1; }
+client -x < "$TOP"/example/simple.conf 2>/dev/null && { echo "FAIL: option not rejected"; exit 1; }
+
+kill -TERM $SERVER; wait $SERVER
+[ -e "$TMP"/sock ] && { echo "FAIL: socket left"; exit 1; }
+
+echo "PASS"
@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# run the shaping example with --execute against the stubs in test/stub
+# (tc included): one netem qdisc per shaped tap, the port settings over
+# the switch ones, installed before the VMs are started (with phases and
+# with the graph); invalid settings and ports without a tap are rejected.
+# Then 10000 shaped links: tc -batch commands of 512 taps each.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$TOP"/test/stub/* "$TMP" && cd "$TMP" || exit 1
+PATH="$TMP:$PATH"; export PATH
+
+for mode in "" "-d"; do
+    rm -f tc.log tc.batch log-*.txt
+    "$TOP"/topo-builder -c "$TOP"/example/shaping.conf -x -j 4 $mode 2>/dev/null || { echo "FAIL: execute $mode"; exit 1; }
+    sleep 1
+    [ "$(wc -l < tc.log)" -eq 1 ] || { echo "FAIL: tc commands $mode"; exit 1; }
+    grep -qx "qdisc replace dev tap2 root netem delay 20ms 5ms loss 0.1% rate 10mbit" tc.batch || { echo "FAIL: switch shaping $mode"; exit 1; }
+    grep -qx "qdisc replace dev tap3 root netem delay 20ms 5ms loss 0.1% rate 2mbit" tc.batch || { echo "FAIL: port shaping $mode"; exit 1; }
+    grep -q "tap1" tc.batch && { echo "FAIL: unshaped tap $mode"; exit 1; }
+    [ -s log-1.txt ] && [ -s log-2.txt ] || { echo "FAIL: VMs not started $mode"; exit 1; }
+done
+
+rm -f tc.batch log-*.txt
+STUB_FAIL=tap3 "$TOP"/topo-builder -c "$TOP"/example/shaping.conf -x -j 4 2>/dev/null && { echo "FAIL: error not reported"; exit 1; }
+sleep 1
+[ -e log-1.txt ] && { echo "FAIL: VMs started after a failed shaping"; exit 1; }
+
+# invalid settings...
+
+for s in "delay 20" "delay \"20ms;reboot\"" "loss 101%" "rate fast" "jitter 5ms"; do
+    sed "s/\[ delay 20ms jitter 5ms loss 0.1% rate 10mbit \]/[ $s ]/" "$TOP"/example/shaping.conf > bad.conf
+    "$TOP"/topo-builder -c bad.conf >/dev/null 2>&1 && { echo "FAIL: $s accepted"; exit 1; }
+done
+
+sed "s/( wan0   bridge )/( wan0   p2p )/" "$TOP"/example/shaping.conf > p2p.conf
+"$TOP"/topo-builder -c p2p.conf 2>&1 >/dev/null | grep -q "has no tap" || { echo "FAIL: p2p port shaped"; exit 1; }
+
+# 10000 shaped links (5000 routers with two ports)...
+
+{
+    echo "switches = [ ( wan0 bridge ) ]"
+    echo "nodes = ["
+    i=0
+    while [ $i -lt 5000 ]; do
+        echo "( r$i image \"r.img\" tty $i [ 10.0.0.1/8 -> wan0 10.0.0.2/8 -> wan0 ] )"
+        i=$((i + 1))
+    done
+    echo "]"
+    echo "settings = [ wan0 -> [ delay 10ms loss 1% ] ]"
+} > big.conf
+
+n=$("$TOP"/topo-builder -c big.conf 2>/dev/null | grep -c "tc -force -batch")
+[ "$n" -eq 20 ] || { echo "FAIL: $n tc commands for 10000 links"; exit 1; }
+
+echo "PASS"
@@ -0,0 +1,122 @@
+//
+// show(ostream, v): the same text as show(v) for nested containers, pairs,
+// tuples and arrays, the first/last n elements with a limit; then the time
+// and the peak size of the string of a large map (show) against streaming
+// it through a buffer (show to ostream).
+//
+// g++ -std=c++0x -O3 -I lib test/show-bench.cpp -o show-bench
+//
+
+#include <show.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+    int failed = 0;
+
+    template <typename T>
+    void
+    check(T const &v)
+    {
+        std::ostringstream out;
+        show(out, v);
+
+        if (out.str() != show(v)) {
+            std::cerr << "FAIL: [" << out.str() << "] != [" << show(v) << "]" << std::endl;
+            failed++;
+        }
+    }
+
+    template <typename T>
+    void
+    check_limit(T const &v, size_t limit, std::string const &expected)
+    {
+        std::ostringstream out;
+        show(out, v, limit);
+
+        if (out.str() != expected) {
+            std::cerr << "FAIL: [" << out.str() << "] != [" << expected << "]" << std::endl;
+            failed++;
+        }
+    }
+
+    typedef std::chrono::steady_clock clock_type;
+
+    double
+    ms_since(clock_type::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    std::vector<int> empty;
+    std::vector<int> v { 1, 2, 3, 4, 5, 6, 7 };
+    std::map<std::string, std::tuple<int, std::vector<std::string>>> m {
+        { "a", std::make_tuple(1, std::vector<std::string>{ "x", "y" }) },
+        { "b", std::make_tuple(2, std::vector<std::string>{}) } };
+    std::array<std::pair<int, char>, 2> a {{ { 1, 'a' }, { 2, 'b' } }};
+    int carr[3] = { 7, 8, 9 };
+
+    check(empty);
+    check(v);
+    check(m);
+    check(a);
+    check_limit(carr, 0, "{ 7 8 9 }");          // show(carr) is the pointer
+    check(std::make_pair(std::string("k"), v));
+    check(std::make_tuple(v, std::string("s"), 3.5, 'c'));
+    check(std::vector<std::vector<int>>{ v, empty, v });
+
+    check_limit(v, 0, "{ 1 2 3 4 5 6 7 }");
+    check_limit(v, 2, "{ 1 2 ...(+3) 6 7 }");
+    check_limit(v, 3, "{ 1 2 3 ...(+1) 5 6 7 }");
+    check_limit(v, 4, "{ 1 2 3 4 5 6 7 }");
+    check_limit(std::vector<std::vector<int>>{ v, v, v }, 1, "{ { 1 ...(+5) 7 } ...(+1) { 1 ...(+5) 7 } }");
+
+    // benchmark: a map of tuples, the shape of the switch map...
+    //
+
+    std::map<std::string, std::tuple<std::string, int, std::vector<int>>> big;
+    for(size_t i = 0; i < n; ++i)
+        big.emplace("sw" + std::to_string(i), std::make_tuple("bridge", 4, std::vector<int>{ int(i), int(i + 1) }));
+
+    std::ofstream null("/dev/null");
+
+    auto t = clock_type::now();
+    auto s = show(big);
+    null << s << std::endl;
+    auto t_string = ms_since(t);
+
+    t = clock_type::now();
+    show(null, big) << std::endl;
+    auto t_stream = ms_since(t);
+
+    std::ostringstream out;
+    show(out, big);
+    if (out.str() != s) {
+        std::cerr << "FAIL: large map" << std::endl;
+        failed++;
+    }
+
+    std::cout << n << " entries, " << s.size() << " bytes" << std::endl;
+    std::cout << "show (string)    : " << t_string << " ms" << std::endl;
+    std::cout << "show (ostream)   : " << t_stream << " ms" << std::endl;
+
+    if (failed)
+        return 1;
+
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+#
+# --stats: one JSON line on stderr with the phases of the build and the
+# item counts, the plan on stdout unchanged; perf counters are optional.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$TOP"/topo-builder -c "$TOP"/example/simple.conf > "$TMP/plan" || { echo "FAIL: build"; exit 1; }
+"$TOP"/topo-builder -c "$TOP"/example/simple.conf --stats > "$TMP/plan.stats" 2> "$TMP/stats" || { echo "FAIL: build --stats"; exit 1; }
+
+cmp -s "$TMP/plan" "$TMP/plan.stats" || { echo "FAIL: plan changed"; exit 1; }
+[ $(wc -l < "$TMP/stats") -eq 1 ] || { echo "FAIL: not a single line"; exit 1; }
+
+for phase in parse switch_map tap_map script emit; do
+    grep -q "{\"name\":\"$phase\",\"wall_us\":[0-9]*[,}]" "$TMP/stats" || { echo "FAIL: phase $phase"; exit 1; }
+done
+
+grep -q '"counts":{"switches":2,"nodes":2,"ports":4,"lines":5}' "$TMP/stats" || { echo "FAIL: counts"; exit 1; }
+grep -q '"nodes_per_s":[0-9]' "$TMP/stats" || { echo "FAIL: throughput"; exit 1; }
+grep -q '"perf":"ok"\|"perf":"unavailable: ' "$TMP/stats" || { echo "FAIL: perf"; exit 1; }
+
+if grep -q '"perf":"ok"' "$TMP/stats"; then
+    grep -q '"cycles":[0-9]*,"instructions":[0-9]*,"cache_misses":[0-9]*' "$TMP/stats" || { echo "FAIL: counters"; exit 1; }
+fi
+
+echo "PASS"
@@ -0,0 +1,3 @@
+#!/bin/sh
+# stub: pretend to load kvm modules...
+exit 0
@@ -0,0 +1,12 @@
+#!/bin/sh
+# stub: pretend to boot a VM (STUB_BOOT: seconds to the login prompt,
+# STUB_RUN: keep running until killed, STUB_EXIT: exit status)...
+echo "startmv.sh $*"
+sleep ${STUB_DELAY:-0}
+if [ -n "$STUB_BOOT" ]; then
+    ( sleep "$STUB_BOOT"; echo "login:" ) &
+fi
+if [ -n "$STUB_RUN" ]; then
+    while :; do sleep 1; done
+fi
+exit ${STUB_EXIT:-0}
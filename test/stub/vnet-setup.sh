@@ -0,0 +1,5 @@
+#!/bin/sh
+# stub: pretend to create a switch...
+[ -n "$STUB_FAIL" ] && echo "$*" | grep -q -- "$STUB_FAIL" && exit 1
+sleep ${STUB_DELAY:-0}
+exit 0
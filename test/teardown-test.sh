@@ -0,0 +1,71 @@
+#!/bin/sh
+#
+# bring the example topology up (--netlink, VMs kept running by the stub
+# startmv.sh) inside an unprivileged user+net+pid namespace, then tear it
+# down: from the state file through rtnetlink (the VMs stopped by their
+# process group), and from the config through the generated ip -batch
+# commands (the VMs found by their command line, one stop per batch). A
+# process that merely mentions a tap, like tcpdump -i tap1, is left alone,
+# and so is an unrelated process group recorded in a stale state file.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$TOP"/test/stub/*.sh "$TMP" && cd "$TMP" || exit 1
+
+exec unshare -Urnp --fork --mount-proc sh -e -c '
+    check_down()
+    {
+        sleep 1
+        pgrep -f "[s]tartmv.sh" >/dev/null && { echo "FAIL: VMs still running ($1)"; exit 1; }
+        for d in 1 2 3 4; do
+            ip link show tap$d >/dev/null 2>&1 && { echo "FAIL: tap$d still there ($1)"; exit 1; }
+        done
+        for d in 0 1; do
+            ip link show vswitch$d >/dev/null 2>&1 && { echo "FAIL: vswitch$d still there ($1)"; exit 1; }
+        done
+        return 0
+    }
+
+    sh -c "while :; do sleep 1; done" tcpdump -i tap1 &
+    decoy=$!
+
+    STUB_RUN=1 "$1"/topo-builder -c "$1"/example/simple.conf -x -N -S state.txt 2>/dev/null || { echo "FAIL: execute"; exit 1; }
+    sleep 1
+    [ $(pgrep -c -f "[s]tartmv.sh") -eq 2 ] || { echo "FAIL: VMs not running"; exit 1; }
+    grep -q "^bridge vswitch1$" state.txt || { echo "FAIL: state file"; exit 1; }
+    [ $(grep -c "^vm vrouter[01] .* [1-9][0-9]*$" state.txt) -eq 2 ] || { echo "FAIL: process groups not recorded"; exit 1; }
+
+    "$1"/topo-builder -D -S state.txt > down.txt 2>/dev/null || { echo "FAIL: teardown plan"; exit 1; }
+    [ $(grep -c "pkill -TERM -g [0-9]*,[0-9]* " down.txt) -eq 1 ] || { echo "FAIL: one stop by process group"; exit 1; }
+
+    "$1"/topo-builder -D -S state.txt -x -N -j 4 -W 2 2>/dev/null || { echo "FAIL: teardown (state)"; exit 1; }
+    check_down state
+
+    STUB_RUN=1 "$1"/topo-builder -c "$1"/example/simple.conf -x -N 2>/dev/null || { echo "FAIL: execute"; exit 1; }
+    sleep 1
+    "$1"/topo-builder -c "$1"/example/simple.conf -D > down.txt 2>/dev/null || { echo "FAIL: teardown plan"; exit 1; }
+    [ $(grep -c "pkill -TERM -f " down.txt) -eq 1 ] || { echo "FAIL: one stop by pattern"; exit 1; }
+    "$1"/topo-builder -c "$1"/example/simple.conf -D -x -j 4 -W 2 2>/dev/null || { echo "FAIL: teardown (config)"; exit 1; }
+    check_down config
+
+    kill -0 $decoy 2>/dev/null || { echo "FAIL: unrelated process stopped"; exit 1; }
+    kill $decoy
+
+    # a stale state file: its process group now belongs to another
+    # process, which is left alone...
+    setsid sh -c "while :; do sleep 1; done" &
+    other=$!
+    sleep 1
+    echo "vm vrouter0 [t]ap1([^0-9]|\$) $other" > stale.txt
+    "$1"/topo-builder -D -S stale.txt -x -W 1 2>/dev/null || { echo "FAIL: teardown (stale)"; exit 1; }
+    kill -0 $other 2>/dev/null || { echo "FAIL: stale process group stopped"; exit 1; }
+    kill $other
+
+    # nothing left: tearing down again is not an error...
+    "$1"/topo-builder -c "$1"/example/simple.conf -D -x 2>/dev/null || { echo "FAIL: teardown (empty)"; exit 1; }
+
+    echo PASS
+' sh "$TOP"
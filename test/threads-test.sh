@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# make_vms on threads: the plan of a large topology built with --threads
+# 4 and 0 (one per CPU) must be the same as the sequential one, in every
+# format, and a failing node must give the same error. Prints the time of
+# the script phase for each thread count.
+#
+# usage: threads-test.sh [N]   (default 100000)
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+N=${1:-100000}
+
+{
+    echo "switches = ["
+    i=0
+    while [ $i -lt $(( (N + 199) / 200 )) ]; do
+        echo "( lan$i bridge ) ( vale$i vale )"
+        i=$((i + 1))
+    done
+    echo "( alink0 p2p ) ( alink1 p2p ) ( alink2 p2p ) ( alink3 p2p ) ]"
+    echo "nodes = ["
+    echo "( p[0..3] image \"p{i}.img\" tty {i+$((N + 1))} [ 12.0.0.{i}/24 -> alink{i/2} ] )"
+    echo "( a[0..$((N - 1))] overlay \"base.qcow2\" tty {i+1} [ 10.{i/65536}.{i/256%256}.{i%256}/8 -> lan{i/200} 11.0.0.{i%256}/8 -> vale{i/200} ] )"
+    echo "( q[0..3] image \"q{i}.img\" tty {i+$((N + 5))} [ 12.0.1.{i}/24 -> alink{i/2+2} ] )"
+    echo "]"
+    echo "settings = [ a0 -> [ smp 2 ] ]"
+} > "$TMP"/big.conf
+
+for fmt in sh json; do
+    "$TOP"/topo-builder -c "$TMP"/big.conf -a -f $fmt > "$TMP"/seq.$fmt 2>/dev/null || { echo "FAIL: sequential build"; exit 1; }
+    for t in 4 0; do
+        "$TOP"/topo-builder -c "$TMP"/big.conf -a -f $fmt --threads $t > "$TMP"/par.$fmt 2>/dev/null || { echo "FAIL: build on $t threads"; exit 1; }
+        cmp -s "$TMP"/seq.$fmt "$TMP"/par.$fmt || { echo "FAIL: $fmt plan on $t threads"; exit 1; }
+    done
+done
+
+# UDP ports of the p2p links (1 ... 8) out of range, in the first and in
+# the last range of nodes...
+
+seq=$("$TOP"/topo-builder -c "$TMP"/big.conf --p2p-port -6 2>&1 >/dev/null)
+par=$("$TOP"/topo-builder -c "$TMP"/big.conf --p2p-port -6 --threads 4 2>&1 >/dev/null)
+[ -n "$seq" ] && [ "$seq" = "$par" ] || { echo "FAIL: error on threads [$par] [$seq]"; exit 1; }
+
+for t in 1 2 4; do
+    "$TOP"/topo-builder -c "$TMP"/big.conf -a --threads $t --stats 2>&1 >/dev/null |
+        sed -n 's/.*"name":"script","wall_us":\([0-9]*\).*/\1/p' |
+        { read us; printf "%d nodes, %d thread(s): script %d ms\n" $N $t $((us / 1000)); }
+done
+
+echo "PASS"
@@ -0,0 +1,120 @@
+//
+// minimal client of topo-builder --listen for server-test.sh: sends the
+// options (the -c file made absolute, otherwise the config read from
+// stdin), writes the plan to stdout and "hit" or "miss" (parsed config
+// cache) to stderr.
+//
+// usage: topo-client socket [options...] [< config]
+//
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static bool
+write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        auto r = write(fd, p, n);
+        if (r <= 0)
+            return false;
+        p += r; n -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+        return 2;
+
+    std::string req;
+    bool inline_config = true;
+
+    for(int i = 2; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+
+        if ((arg == "-c" || arg == "--config") && i + 1 < argc)
+        {
+            char path[PATH_MAX];
+            if (!realpath(argv[++i], path))
+                return perror(argv[i]), 1;
+            arg += std::string(" ") + path;
+            inline_config = false;
+        }
+
+        req += (req.empty() ? "" : " ") + arg;
+    }
+
+    req += '\n';
+
+    if (inline_config)
+    {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0)
+            req.append(buf, n);
+    }
+
+    sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, argv[1], sizeof(sa.sun_path) - 1);
+
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0 || connect(s, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0)
+        return perror("topo-client"), 1;
+
+    if (!write_all(s, req.data(), req.size()) || shutdown(s, SHUT_WR) < 0)
+        return perror("topo-client"), 1;
+
+    // reply line, then the plan...
+    //
+
+    std::string in;
+    char buf[65536];
+    ssize_t n;
+
+    while (in.find('\n') == std::string::npos && (n = read(s, buf, sizeof(buf))) > 0)
+        in.append(buf, static_cast<size_t>(n));
+
+    auto eol = in.find('\n');
+    if (eol == std::string::npos)
+        return fprintf(stderr, "topo-client: no reply\n"), 1;
+
+    auto reply = in.substr(0, eol);
+    if (reply.compare(0, 3, "ok ") != 0)
+        return fprintf(stderr, "topo-client: %s\n", reply.c_str()), 1;
+
+    char cache[16] = "";
+    unsigned long size = 0;
+    sscanf(reply.c_str(), "ok %lu %15s", &size, cache);
+
+    auto plan = in.substr(eol + 1);
+    if (!write_all(1, plan.data(), plan.size()))
+        return 1;
+
+    unsigned long total = plan.size();
+
+    while ((n = read(s, buf, sizeof(buf))) > 0)
+    {
+        if (!write_all(1, buf, static_cast<size_t>(n)))
+            return 1;
+        total += static_cast<unsigned long>(n);
+    }
+
+    if (total != size)
+        return fprintf(stderr, "topo-client: short plan (%lu of %lu bytes)\n", total, size), 1;
+
+    fprintf(stderr, "%s\n", cache);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# dry run of the VALE example (no netmap needed): each port is created
+# and attached once by the bridges phase, the VMs open it by its own
+# name (vpN, not valeX:vpN which would attach it again), with phases and
+# with the graph; --ptnetmap gives passthrough NICs, the teardown
+# detaches and removes the ports, and a switch has at most 254 ports.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cd "$TMP" || exit 1
+
+for mode in "" "-d"; do
+    "$TOP"/topo-builder -c "$TOP"/example/vale.conf -x -n $mode > run.txt 2>/dev/null || { echo "FAIL: dry run $mode"; exit 1; }
+    grep -qF "sh -c 'vale-ctl -n vp2 && vale-ctl -a valesw0:vp2 && vale-ctl -n vp3 && vale-ctl -a valesw0:vp3'" run.txt || { echo "FAIL: valesw0 ports $mode"; exit 1; }
+    grep -qF "sh -c 'vale-ctl -n vp4 && vale-ctl -a vale1:vp4'" run.txt || { echo "FAIL: vale1 ports $mode"; exit 1; }
+    grep -qF -- "-netdev netmap,id=net0,ifname=vp2 -device virtio-net-pci,netdev=net0 -netdev netmap,id=net1,ifname=vp4 " run.txt || { echo "FAIL: vrouter0 NICs $mode"; exit 1; }
+    grep -qF -- "-netdev netmap,id=net0,ifname=vp3 -device virtio-net-pci,netdev=net0 -netdev tap,id=net1,ifname=tap1," run.txt || { echo "FAIL: vrouter1 NICs $mode"; exit 1; }
+    grep -q "ifname=vale" run.txt && { echo "FAIL: port attached again by a VM $mode"; exit 1; }
+done
+
+"$TOP"/topo-builder -c "$TOP"/example/vale.conf -P > run.txt 2>/dev/null || { echo "FAIL: ptnetmap"; exit 1; }
+[ $(grep -c "ifname=vp[0-9],passthrough=on -device ptnet-pci," run.txt) -eq 2 ] || { echo "FAIL: ptnetmap NICs"; exit 1; }
+
+"$TOP"/topo-builder -c "$TOP"/example/vale.conf -D -x -n > down.txt 2>/dev/null || { echo "FAIL: teardown"; exit 1; }
+grep -qF "vale-ctl -d valesw0:vp2; vale-ctl -r vp2; vale-ctl -d valesw0:vp3; vale-ctl -r vp3; vale-ctl -d vale1:vp4; vale-ctl -r vp4;" down.txt || { echo "FAIL: teardown ports"; exit 1; }
+
+{
+    echo "switches = [ ( sw0 vale ) ]"
+    echo "nodes = [ ( r[0..254] image \"r.img\" tty {i} [ 10.0.{i/256}.{i%256}/16 -> sw0 ] ) ]"
+} > big.conf
+
+"$TOP"/topo-builder -c big.conf 2>&1 >/dev/null | grep -q "too many ports" || { echo "FAIL: 255 ports accepted"; exit 1; }
+
+echo "PASS"
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# run the vhost-user example with --execute against the stubs in
+# test/stub: the port map of the switch and the sockets of the qemu NICs
+# are the same absolute paths, the guest memory is shared hugepages of
+# the size set by mem (with phases and with the graph). A node of a
+# vhost-user switch without mem is rejected; the teardown removes the
+# sockets and the port map.
+#
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$TOP"/test/stub/* "$TMP" && cd "$TMP" || exit 1
+PATH="$TMP:$PATH"; export PATH
+
+for mode in "" "-d"; do
+    rm -rf vhost log-*.txt
+    "$TOP"/topo-builder -c "$TOP"/example/vhostuser.conf -x -j 4 --hugepages /mnt/huge $mode 2>/dev/null || { echo "FAIL: execute $mode"; exit 1; }
+    sleep 1
+    [ "$(cat vhost/vswitch0.ports)" = "$(printf "vu1 %s\nvu2 %s" "$PWD/vhost/vu1.sock" "$PWD/vhost/vu2.sock")" ] || { echo "FAIL: port map $mode"; exit 1; }
+    grep -qF "path=$PWD/vhost/vu1.sock," log-1.txt || { echo "FAIL: vrouter0 socket $mode"; exit 1; }
+    grep -qF "path=$PWD/vhost/vu2.sock," log-2.txt || { echo "FAIL: vrouter1 socket $mode"; exit 1; }
+    grep -qF -- "-m 1024 -object memory-backend-file,id=mem,size=1024M,mem-path=/mnt/huge,share=on -numa node,memdev=mem " log-1.txt || { echo "FAIL: vrouter0 memory $mode"; exit 1; }
+    grep -qF -- "-m 256 -object memory-backend-file,id=mem,size=256M,mem-path=/mnt/huge,share=on -numa node,memdev=mem " log-2.txt || { echo "FAIL: vrouter1 memory $mode"; exit 1; }
+    grep -qF -- "-netdev tap,id=net1,ifname=tap3," log-1.txt || { echo "FAIL: vrouter0 tap $mode"; exit 1; }
+done
+
+# the guest memory size is required...
+
+grep -v "vrouter1        -> \[ mem 256 \]" "$TOP"/example/vhostuser.conf > nomem.conf
+"$TOP"/topo-builder -c nomem.conf 2>&1 >/dev/null | grep -q "vhostuser: vrouter1: mem must be set" || { echo "FAIL: no mem accepted"; exit 1; }
+
+"$TOP"/topo-builder -c "$TOP"/example/vhostuser.conf -D > down.txt 2>/dev/null || { echo "FAIL: teardown"; exit 1; }
+grep -qF "rm -f vhost/vu1.sock vhost/vu2.sock vhost/vswitch0.ports" down.txt || { echo "FAIL: teardown files"; exit 1; }
+
+echo "PASS"
@@ -1,10 +1,25 @@
 #include <parser/basic.hpp>
 #include <builder.hpp>
-#include <global.hpp>
+#include <teardown.hpp>
+#include <context.hpp>
+#include <stats.hpp>
+#include <server.hpp>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <set>
 #include <string>
 #include <stdexcept>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 void usage(const char *name)
 {
@@ -14,9 +29,210 @@ void usage(const char *name)
           "   -i, --append-ip             Pass IP address to guest kernel image\n"
           "   -k, --kernel file           Specify the kernel image (default: Core/boot/vmlinuz)\n" 
           "   -C, --core file             Specify the core file    (default: Core/boot/core.gz)\n" 
+          "   -P, --ptnetmap              Use ptnetmap passthrough NICs on VALE switches\n"
+          "   -O, --overlay-dir dir       Directory of the per-VM qcow2 overlays (default: overlay)\n"
+          "   -Q, --qmp dir               Give each VM a QMP socket in dir (dir/<vm>.sock)\n"
+          "       --vhost-dir dir         Directory of the vhost-user sockets and port maps (default: vhost)\n"
+          "       --hugepages dir         Hugepage mount backing the VMs on vhost-user switches (default: /dev/hugepages)\n"
+          "       --p2p-port n            UDP ports of the p2p links: n + port index (default: 20000)\n"
+          "       --initrd-cache dir      Boot the VMs on an uncompressed copy of the core file, kept in dir\n"
+          "Output:\n"
+          "   -f, --format fmt            Output format: sh, json or bin (default: sh)\n"
+          "       --threads n             Threads generating the VM command lines (default: 1, 0: one per CPU)\n"
+          "Execution:\n"
+          "   -x, --execute               Run the plan instead of printing the script\n"
+          "   -j, --jobs n                Max number of commands in flight (default: 1)\n"
+          "   -s, --shell file            Shell used to run commands (default: /bin/bash)\n"
+          "   -d, --dag                   Schedule by dependency graph instead of phases\n"
+          "   -g, --graph                 Print the dependency graph (dot format)\n"
+          "   -N, --netlink               Create bridges and taps through rtnetlink\n"
+          "   -n, --dry-run               Schedule the plan, print commands instead of running them\n"
+          "   -H, --hotplug file          Hot-plug NICs of VMs running with config file (requires --qmp)\n"
+          "       --admission             Pace the VM launches on the host load (PSI, loadavg, free memory)\n"
+          "       --proc dir              Read the host load from dir instead of /proc\n"
+          "       --prewarm               Load kernel, core and shared images into the page cache before the launches\n"
+          "       --launch-grace ms       A VM still running after ms is launched, an earlier exit is its status (default: 1000)\n"
+          "Server:\n"
+          "   -L, --listen socket         Serve plans on the unix socket (requests: -c, -f, -i, -k, -C, -P, -O, -Q,\n"
+          "                               --vhost-dir, --hugepages, --p2p-port, --initrd-cache), -j requests at a time\n"
+          "       --cache n               Number of parsed configs kept by the server (default: 16)\n"
+          "Batch:\n"
+          "   -b, --batch dir             Build the config files given as arguments, -j at a time,\n"
+          "                               into dir/<config>.<fmt>\n"
+          "Teardown:\n"
+          "   -S, --state file            Save what is created to file (bring-up) or read it (teardown)\n"
+          "   -D, --teardown              Stop the VMs, delete taps and bridges (config or state file)\n"
+          "   -W, --stop-timeout sec      Kill the VMs still running after sec seconds (default: 10)\n"
+          "Monitor:\n"
+          "   -M, --monitor               Wait for the VMs to boot, report launch-to-ready times\n"
+          "   -R, --ready pattern         Readiness pattern in the console log (default: login:)\n"
+          "   -T, --ready-timeout sec     Give up waiting after sec seconds (default: 300)\n"
           "General:\n"
           "   -h, --help                  Display help message\n" 
-          "   -v, --verbose               Verbose mode\n");
+          "   -v, --verbose               Verbose mode\n"
+          "       --verbose-limit n       Show only the first and last n elements of each container in -v\n"
+          "       --stats                 Print phase times, counts and perf counters (JSON on stderr)\n"
+          "Scripts (options of the external scripts in the plan):\n"
+          "   startmv.sh -Q \"opts\"         QEMU options replacing the default NIC ones (tuned, VALE,\n"
+          "                               vhost-user, p2p or QMP NICs; vCPUs, memory)\n"
+          "   vnet-setup.sh -q \"N M...\"    Taps N, M... created multiqueue (queues > 1)\n");
+}
+
+
+// parse the config file and build (tear down, hot-plug) its topology...
+//
+
+int
+build_config(topo::context &ctx, topo::parser_type pt, const char *config_file, const char *running_file)
+{
+    topo::stats::scope phase(ctx.recorder, "parse");
+
+    switch(pt)
+    {
+    case topo::parser_type::basic:
+        {
+            topo::basic::parser::type config;
+                                               
+            ///////////////////////////////////////////////////////////////////
+            // parse config file...
+
+            if (!config.load(config_file, more::key_value_opt::non_strict().
+                                                               separator('=').
+                                                               comment('#')))
+                throw std::runtime_error("parse error in config file!");
+
+            if (ctx.teardown)
+            {
+                return topo::destroy(ctx, std::move(more::get<topo::basic::parser::switches>(config)),
+                                          std::move(more::get<topo::basic::parser::nodes>(config)));
+            }
+
+            if (running_file)
+            {
+                topo::basic::parser::type running;
+
+                if (!running.load(running_file, more::key_value_opt::non_strict().
+                                                                    separator('=').
+                                                                    comment('#')))
+                    throw std::runtime_error("parse error in running config file!");
+
+                return topo::hotplug(ctx, std::move(more::get<topo::basic::parser::switches>(config)),
+                                          std::move(more::get<topo::basic::parser::nodes>(running)),
+                                          std::move(more::get<topo::basic::parser::nodes>(config)));
+            }
+
+            return topo::builder(ctx, std::move(more::get<topo::basic::parser::switches>(config)),
+                                      std::move(more::get<topo::basic::parser::nodes>(config)),
+                                      std::move(more::get<topo::basic::parser::settings>(config)));
+
+        } break;
+    default: throw std::runtime_error("internal error");
+    };
+
+    return 0;
+}
+
+
+// with --stats, the statistics of the build are printed at the end,
+// as a single JSON line on stderr...
+//
+
+int
+build(topo::context &ctx, topo::parser_type pt, const char *config_file, const char *running_file)
+{
+    if (!ctx.stats)
+        return build_config(ctx, pt, config_file, running_file);
+
+    topo::stats::recorder rec(config_file);
+
+    ctx.recorder = &rec;
+
+    auto ret = build_config(ctx, pt, config_file, running_file);
+
+    ctx.recorder = nullptr;
+
+    std::cerr << rec.json() << std::flush;
+    return ret;
+}
+
+
+// batch mode: build many configs concurrently, each one with its own
+// context and output file (dir/<config basename>.<format>)...
+//
+
+std::string
+batch_output(std::string const &dir, std::string const &config, std::string const &format)
+{
+    auto name = config.substr(config.find_last_of('/') + 1);
+    auto dot  = name.find_last_of('.');
+
+    if (dot != std::string::npos && dot != 0)
+        name.resize(dot);
+
+    return dir + "/" + name + "." + format;
+}
+
+
+int
+batch(topo::context const &ctx, topo::parser_type pt, std::string const &dir, std::vector<std::string> const &configs)
+{
+    std::set<std::string> outputs;
+
+    for(auto & c : configs)
+    {
+        if (!outputs.insert(batch_output(dir, c, ctx.format)).second)
+            throw std::runtime_error("batch: " + c + ": output " + batch_output(dir, c, ctx.format) + " already in use");
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failed(0);
+    std::mutex err_mutex;
+
+    auto worker = [&]()
+    {
+        for(size_t i; (i = next++) < configs.size(); )
+        {
+            auto path = batch_output(dir, configs[i], ctx.format);
+
+            topo::context c(ctx);
+
+            c.output = ::open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+
+            int ret = 1;
+
+            try
+            {
+                if (c.output < 0)
+                    throw std::runtime_error("cannot write " + path + ": " + strerror(errno));
+
+                ret = build(c, pt, configs[i].c_str(), nullptr);
+            }
+            catch(std::exception &e)
+            {
+                std::lock_guard<std::mutex> lock(err_mutex);
+                std::cerr << "batch: " << configs[i] << ": " << e.what() << std::endl;
+            }
+
+            if (c.output >= 0 && ::close(c.output) < 0)
+                ret = 1;
+
+            if (ret != 0)
+                failed++;
+        }
+    };
+
+    std::vector<std::thread> pool;
+
+    for(size_t n = 0; n < std::min<size_t>(std::max(ctx.jobs, 1), configs.size()); ++n)
+        pool.emplace_back(worker);
+
+    for(auto & t : pool)
+        t.join();
+
+    if (failed)
+        std::cerr << "batch: " << failed << " of " << configs.size() << " config(s) failed" << std::endl;
+
+    return failed ? 1 : 0;
 }
 
 
@@ -30,7 +246,16 @@ try
     if (argc < 2)
         usage(argv[0]);
     
+    topo::context ctx;
+
     const char *config_file = nullptr;
+    const char *running_file = nullptr;
+    const char *batch_dir = nullptr;
+    const char *listen_path = nullptr;
+
+    size_t cache_size = 16;
+
+    std::vector<std::string> configs;
 
     topo::parser_type pt = topo::parser_type::basic;
 
@@ -60,7 +285,7 @@ try
                 throw std::runtime_error("argument missing");
             }
 
-            global::instance().kernel = argv[i];
+            ctx.kernel = argv[i];
             continue;
         }
 
@@ -71,56 +296,408 @@ try
                 throw std::runtime_error("argument missing");
             }
 
-            global::instance().core = argv[i];
+            ctx.core = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], "-f", "--format")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.format = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], "-O", "--overlay-dir")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.overlay_dir = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--vhost-dir")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.vhost_dir = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--initrd-cache")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.initrd_cache = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--p2p-port")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.p2p_port = std::stoi(argv[i]);
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--hugepages")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.hugepages = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], "-Q", "--qmp")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.qmp = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], "-H", "--hotplug")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            running_file = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], "-b", "--batch")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            batch_dir = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], "-L", "--listen")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            listen_path = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--cache")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            cache_size = std::stoul(argv[i]);
+            continue;
+        }
+
+        if (is_opt(argv[i], "-j", "--jobs")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.jobs = std::stoi(argv[i]);
+            continue;
+        }
+
+        if (is_opt(argv[i], "-s", "--shell")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.shell = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], "-S", "--state")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.state = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], "-W", "--stop-timeout")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.stop_timeout = std::stoi(argv[i]);
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--launch-grace")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.launch_grace = std::stoi(argv[i]);
+            continue;
+        }
+
+        if (is_opt(argv[i], "-D", "--teardown"))
+        {
+            ctx.teardown = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], "-R", "--ready")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.ready = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], "-T", "--ready-timeout")) 
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.ready_timeout = std::stoi(argv[i]);
+            continue;
+        }
+
+        if (is_opt(argv[i], "-M", "--monitor"))
+        {
+            ctx.monitor = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], "-x", "--execute"))
+        {
+            ctx.execute = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], "-d", "--dag"))
+        {
+            ctx.dag = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], "-g", "--graph"))
+        {
+            ctx.graph = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], "-N", "--netlink"))
+        {
+            ctx.netlink = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], "-n", "--dry-run"))
+        {
+            ctx.dry_run = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], "-P", "--ptnetmap"))
+        {
+            ctx.ptnetmap = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--prewarm"))
+        {
+            ctx.prewarm = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--admission"))
+        {
+            ctx.admission = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--proc"))
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.proc = argv[i];
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--stats"))
+        {
+            ctx.stats = true;
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--threads"))
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.threads = std::stoi(argv[i]);
+            if (ctx.threads < 0)
+                throw std::runtime_error("--threads: invalid value");
+            continue;
+        }
+
+        if (is_opt(argv[i], nullptr, "--verbose-limit"))
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("argument missing");
+            }
+
+            ctx.verbose_limit = std::stoul(argv[i]);
             continue;
         }
 
         if (is_opt(argv[i], "-v", "--verbose"))
         {
-            global::instance().verbose = true;
+            ctx.verbose = true;
             continue;
         }
 
         if (is_opt(argv[i], "-i", "--append-ip"))
         {
-            global::instance().append_ip = true;
+            ctx.append_ip = true;
             continue;
         }
 
         if (is_opt(argv[i], "-h", "--help"))
             usage(argv[0]);
+
+        if (argv[i][0] != '-')
+            configs.push_back(argv[i]);
     }
 
-    if (!config_file)
+    if (ctx.netlink && !ctx.execute)
     {
-        throw std::runtime_error(std::string(argv[0]) + ": config file missing");
+        throw std::runtime_error(std::string(argv[0]) + ": --netlink requires --execute");
     }
-   
-    switch(pt)
+
+    if (ctx.netlink && ctx.dry_run)
     {
-    case topo::parser_type::basic:
-        {
-            topo::basic::parser::type config(config_file);
-                                               
-            ///////////////////////////////////////////////////////////////////
-            // parse config file...
+        throw std::runtime_error(std::string(argv[0]) + ": --netlink cannot be used with --dry-run");
+    }
 
-            if (!config.load(config_file, more::key_value_opt::non_strict().
-                                                               separator('=').
-                                                               comment('#')))
-                throw std::runtime_error("parse error in config file!");
+    if (ctx.monitor && ctx.dry_run)
+    {
+        throw std::runtime_error(std::string(argv[0]) + ": --monitor cannot be used with --dry-run");
+    }
 
-            return topo::builder(std::move(more::get<topo::basic::parser::switches>(config)),
-                                 std::move(more::get<topo::basic::parser::nodes>(config)));
+    if (ctx.admission && !ctx.execute)
+    {
+        throw std::runtime_error(std::string(argv[0]) + ": --admission requires --execute");
+    }
 
-        } break;
-    default: throw std::runtime_error("internal error");
-    };
+    if (ctx.prewarm && !ctx.execute)
+    {
+        throw std::runtime_error(std::string(argv[0]) + ": --prewarm requires --execute");
+    }
 
-    return 0;
+    if (running_file && ctx.qmp.empty())
+    {
+        throw std::runtime_error(std::string(argv[0]) + ": --hotplug requires --qmp");
+    }
+
+    if (batch_dir && (ctx.execute || ctx.dry_run || ctx.teardown || ctx.monitor || ctx.graph || running_file))
+    {
+        throw std::runtime_error(std::string(argv[0]) + ": --batch only generates plans (no --execute, --dry-run, --teardown, --monitor, --graph, --hotplug)");
+    }
+
+    if (listen_path && (batch_dir || ctx.execute || ctx.dry_run || ctx.teardown || ctx.monitor || ctx.graph || ctx.stats ||
+                        running_file || !ctx.state.empty()))
+    {
+        throw std::runtime_error(std::string(argv[0]) + ": --listen only generates plans (no --batch, --execute, --dry-run, --teardown, --monitor, --graph, --stats, --hotplug, --state)");
+    }
+
+    if (ctx.dry_run)
+    {
+        ctx.execute = true;
+    }
+
+    if (listen_path)
+    {
+        return topo::server::run(ctx, listen_path, cache_size);
+    }
+
+    // teardown from the state file saved at bring-up...
+    //
+
+    if (ctx.teardown && !ctx.state.empty())
+    {
+        return topo::teardown::run(topo::teardown::load(ctx.state), ctx);
+    }
+
+    if (batch_dir)
+    {
+        if (config_file)
+            configs.insert(configs.begin(), config_file);
+
+        if (configs.empty())
+            throw std::runtime_error(std::string(argv[0]) + ": config files missing");
+
+        return batch(ctx, pt, batch_dir, configs);
+    }
+
+    if (!config_file)
+    {
+        throw std::runtime_error(std::string(argv[0]) + ": config file missing");
+    }
+
+    return build(ctx, pt, config_file, running_file);
 }
 catch(std::exception &e)
 {
     std::cerr << e.what() << std::endl;
+    return 1;
 }
 